@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+#include "HashMap.h"
+
+// Thread-safe map that partitions keys across a power-of-two number of shards, each being an
+// independent HashMap guarded by its own reader/writer lock. Operations on keys of different
+// shards never contend, and lookups in the same shard proceed in parallel.
+//
+// Values are never handed out by reference: find passes the value to a callback that runs
+// under the shard's shared lock, and upsert updates it in place under the exclusive lock.
+template <class KeyType, class ValueType, class Hash = std::hash<KeyType>, class Equal = std::equal_to<KeyType>,
+          class ProbingPolicy = LinearProbing, class GrowthPolicy = PowerOfTwoGrowthPolicy>
+class ConcurrentHashMap {
+public:
+    using Map = HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>;
+
+    static constexpr size_t kDefaultShardCount = 64;
+
+    // shard_count is rounded up to a power of two.
+    explicit ConcurrentHashMap(size_t shard_count = kDefaultShardCount, Hash hasher = Hash(), Equal equal = Equal());
+    ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+    ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+    size_t shard_count() const;  // NOLINT
+
+    // Both sum over all shards one at a time, so under concurrent updates the result is
+    // only a snapshot of each shard taken at a slightly different moment.
+    size_t size() const;  // NOLINT
+    bool empty() const;   // NOLINT
+
+    // If key is present, calls visitor(const ValueType&) under the shard's shared lock and
+    // returns true. The visitor must not access this map.
+    template <class Visitor>
+    bool find(const KeyType& key, Visitor&& visitor) const;  // NOLINT
+    bool contains(const KeyType& key) const;                  // NOLINT
+
+    // Return true if the element was inserted, false if the key was already present.
+    bool insert(const std::pair<KeyType, ValueType>& element);  // NOLINT
+    bool insert(std::pair<KeyType, ValueType>&& element);       // NOLINT
+
+    // If key is present, calls update(ValueType&) under the shard's exclusive lock, otherwise
+    // inserts ValueType(args...). Returns true if the element was inserted.
+    template <class Update, class... Args>
+    bool upsert(const KeyType& key, Update&& update, Args&&... args);  // NOLINT
+
+    size_t erase(const KeyType& key);  // NOLINT
+
+    // Calls f(Map&) for every shard in turn while holding that shard's exclusive lock, or
+    // f(const Map&) under its shared lock for the const overload.
+    template <class F>
+    void for_each_shard(F&& f);  // NOLINT
+    template <class F>
+    void for_each_shard(F&& f) const;  // NOLINT
+
+    // Reserves count / shard_count() elements in every shard.
+    void reserve(size_t count);  // NOLINT
+    void clear();                // NOLINT
+
+private:
+    // Aligned to a cache line so that the locks of neighbouring shards do not share one.
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        Map map;
+    };
+
+    Shard& get_shard(const KeyType& key);              // NOLINT
+    const Shard& get_shard(const KeyType& key) const;  // NOLINT
+
+    Hash hasher_;
+    size_t shard_mask_;
+    std::unique_ptr<Shard[]> shards_;
+};
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::ConcurrentHashMap(size_t shard_count,
+                                                                                                   Hash hasher,
+                                                                                                   Equal equal)
+    : hasher_(hasher), shard_mask_(0) {
+    while (shard_mask_ + 1 < shard_count) {
+        shard_mask_ = (shard_mask_ << 1) | 1;
+    }
+    shards_.reset(new Shard[shard_mask_ + 1]);
+    for (size_t i = 0; i <= shard_mask_; ++i) {
+        shards_[i].map = Map(hasher, equal);
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+size_t ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::shard_count() const {
+    return shard_mask_ + 1;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+size_t ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::size() const {
+    size_t result = 0;
+    for_each_shard([&result](const Map& map) { result += map.size(); });
+    return result;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+bool ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::empty() const {
+    return size() == 0;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+template <class Visitor>
+bool ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::find(const KeyType& key,
+                                                                                           Visitor&& visitor) const {
+    const Shard& shard = get_shard(key);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+        return false;
+    }
+    visitor(it->second);
+    return true;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+bool ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::contains(
+    const KeyType& key) const {
+    const Shard& shard = get_shard(key);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.map.contains(key);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+bool ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::insert(
+    const std::pair<KeyType, ValueType>& element) {
+    Shard& shard = get_shard(element.first);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.map.insert(element).second;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+bool ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::insert(
+    std::pair<KeyType, ValueType>&& element) {
+    Shard& shard = get_shard(element.first);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.map.insert(std::move(element)).second;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+template <class Update, class... Args>
+bool ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::upsert(const KeyType& key,
+                                                                                             Update&& update,
+                                                                                             Args&&... args) {
+    Shard& shard = get_shard(key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto result = shard.map.try_emplace(key, std::forward<Args>(args)...);
+    if (!result.second) {
+        update(result.first->second);
+    }
+    return result.second;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+size_t ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::erase(const KeyType& key) {
+    Shard& shard = get_shard(key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.map.erase(key);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+template <class F>
+void ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::for_each_shard(F&& f) {
+    for (size_t i = 0; i <= shard_mask_; ++i) {
+        std::unique_lock<std::shared_mutex> lock(shards_[i].mutex);
+        f(shards_[i].map);
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+template <class F>
+void ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::for_each_shard(F&& f) const {
+    for (size_t i = 0; i <= shard_mask_; ++i) {
+        std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+        f(static_cast<const Map&>(shards_[i].map));
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+void ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::reserve(size_t count) {
+    size_t per_shard = count / (shard_mask_ + 1) + 1;
+    for_each_shard([per_shard](Map& map) { map.reserve(per_shard); });
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+void ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::clear() {
+    for_each_shard([](Map& map) { map.clear(); });
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+typename ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Shard&
+ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::get_shard(const KeyType& key) {
+    return const_cast<Shard&>(static_cast<const ConcurrentHashMap*>(this)->get_shard(key));
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+const typename ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Shard&
+ConcurrentHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::get_shard(const KeyType& key) const {
+    // The shard is chosen by the high half of the hash mixed with a multiplier of its own, so it
+    // stays independent of the bits the shard's table uses to pick a bucket and a fingerprint.
+    uint64_t mixed = static_cast<uint64_t>(hasher_(key)) * 0xFF51AFD7ED558CCDull;
+    return shards_[static_cast<size_t>(mixed >> 32) & shard_mask_];
+}
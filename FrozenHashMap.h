@@ -0,0 +1,443 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "HashMap.h"
+
+// Immutable map for tables that are built once and then only read. The keys are placed with a
+// minimal perfect hash in the style of PTHash: each key hashes to a small bucket, every bucket
+// stores a pilot value chosen at build time, and the pilot sends each key of the bucket to its
+// own entry. Entries fill one contiguous array at 100% occupancy, so a lookup is one pilot read,
+// one entry read and a single key comparison, with no probing at all.
+//
+// The pilots send keys into a range about 2% larger than the entry array, which keeps the
+// search for the last pilots short; the few keys sent past the end are redirected through a
+// small remap table to the entries left free. Keys whose hash equals that of another key cannot
+// be told apart by any pilot, so all but one of them go to an overflow list, sorted by hash,
+// that is searched only after the key comparison fails.
+//
+// Building takes expected linear time; a range with equal keys keeps the first one, as
+// HashMap::insert does.
+template <class KeyType, class ValueType, class Hash = std::hash<KeyType>, class Equal = std::equal_to<KeyType>>
+class FrozenHashMap {
+private:
+    template <class K, class Result>
+    using EnableIfTransparent = std::enable_if_t<IsTransparentLookup<Hash, Equal, K>::value, Result>;
+
+public:
+    using value_type = std::pair<const KeyType, ValueType>;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+    using iterator = const_iterator;
+
+    FrozenHashMap();
+    explicit FrozenHashMap(Hash hasher, Equal equal = Equal());
+    template <class Iterator>
+    FrozenHashMap(Iterator begin, Iterator end, Hash hasher = Hash(), Equal equal = Equal());
+    FrozenHashMap(std::initializer_list<std::pair<KeyType, ValueType>> list, Hash hasher = Hash(),
+                  Equal equal = Equal());
+    // Takes the hasher and key comparison of map.
+    template <class ProbingPolicy, class GrowthPolicy, class Allocator>
+    explicit FrozenHashMap(const HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator>& map);
+
+    size_t size() const;  // NOLINT
+    bool empty() const;   // NOLINT
+
+    Hash hash_function() const;  // NOLINT
+    Equal key_eq() const;        // NOLINT
+
+    const_iterator begin() const;  // NOLINT
+    const_iterator end() const;    // NOLINT
+
+    const_iterator find(const KeyType& key) const;  // NOLINT
+    bool contains(const KeyType& key) const;        // NOLINT
+    size_t count(const KeyType& key) const;         // NOLINT
+    const ValueType& at(const KeyType& key) const;  // NOLINT
+    // As in HashMap, these take part in overload resolution only if Hash and Equal are transparent.
+    template <class K>
+    auto find(const K& key) const -> EnableIfTransparent<K, const_iterator>;  // NOLINT
+    template <class K>
+    auto contains(const K& key) const -> EnableIfTransparent<K, bool>;  // NOLINT
+    template <class K>
+    auto count(const K& key) const -> EnableIfTransparent<K, size_t>;  // NOLINT
+
+    // Bytes allocated for the entries and the pilots; memory owned by keys and values is not
+    // counted.
+    size_t memory_usage() const;  // NOLINT
+
+private:
+    // Average number of keys per bucket: larger buckets need fewer pilots but more tries to
+    // place them once the entry array is nearly full.
+    static constexpr size_t kBucketSize = 4;
+    // The pilots send n keys to n + n / kSlack + 1 positions.
+    static constexpr size_t kSlack = 50;
+    // Pilots tried for one bucket before the build starts over with another seed.
+    static constexpr uint32_t kMaxPilot = 1 << 20;
+    static constexpr uint64_t kMaxSeeds = 16;
+    // 0.6 * 2^32, see bucket_for_hash.
+    static constexpr uint32_t kDenseKeyShare = 2576980377u;
+
+    Hash hasher_;
+    Equal equal_;
+    uint64_t seed_ = 0;
+    std::vector<uint32_t> pilots_;
+    // The keys placed by the perfect hash are entries_[0, hashed_count_), the overflow keys
+    // follow them.
+    std::vector<value_type> entries_;
+    size_t hashed_count_ = 0;
+    // remap_[pos - hashed_count_] is the entry the pilots' position pos stands for.
+    std::vector<size_t> remap_;
+    // Hash and entry index of every overflow key, sorted by hash.
+    std::vector<std::pair<uint64_t, size_t>> overflow_;
+
+    template <class Map>
+    void build(const Map& map);  // NOLINT
+    // Tries to find a pilot for every bucket with the current seed; on success remap_ is filled
+    // and position[i] is the entry of the key with hash hashes[i].
+    bool place(const std::vector<uint64_t>& hashes, std::vector<size_t>& position);  // NOLINT
+
+    template <class K>
+    const_iterator find_key(const K& key) const;  // NOLINT
+    template <class K>
+    const_iterator find_overflow(const K& key, uint64_t hash) const;  // NOLINT
+
+    template <class K>
+    uint64_t get_hash(const K& key) const;        // NOLINT
+    size_t bucket_for_hash(uint64_t hash) const;  // NOLINT
+    // The entry, out of count, that pilot sends the key with this hash to.
+    static size_t position_for_hash(uint64_t hash, uint32_t pilot, size_t count);  // NOLINT
+};
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+FrozenHashMap<KeyType, ValueType, Hash, Equal>::FrozenHashMap() : FrozenHashMap(Hash(), Equal()) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+FrozenHashMap<KeyType, ValueType, Hash, Equal>::FrozenHashMap(Hash hasher, Equal equal)
+    : hasher_(hasher), equal_(equal) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+template <class Iterator>
+FrozenHashMap<KeyType, ValueType, Hash, Equal>::FrozenHashMap(Iterator begin, Iterator end, Hash hasher, Equal equal)
+    : FrozenHashMap(HashMap<KeyType, ValueType, Hash, Equal>(begin, end, hasher, equal)) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+FrozenHashMap<KeyType, ValueType, Hash, Equal>::FrozenHashMap(
+    std::initializer_list<std::pair<KeyType, ValueType>> list, Hash hasher, Equal equal)
+    : FrozenHashMap(list.begin(), list.end(), hasher, equal) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+template <class ProbingPolicy, class GrowthPolicy, class Allocator>
+FrozenHashMap<KeyType, ValueType, Hash, Equal>::FrozenHashMap(
+    const HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator>& map)
+    : hasher_(map.hash_function()), equal_(map.key_eq()) {
+    build(map);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+size_t FrozenHashMap<KeyType, ValueType, Hash, Equal>::size() const {
+    return entries_.size();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+bool FrozenHashMap<KeyType, ValueType, Hash, Equal>::empty() const {
+    return entries_.empty();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+Hash FrozenHashMap<KeyType, ValueType, Hash, Equal>::hash_function() const {
+    return hasher_;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+Equal FrozenHashMap<KeyType, ValueType, Hash, Equal>::key_eq() const {
+    return equal_;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+typename FrozenHashMap<KeyType, ValueType, Hash, Equal>::const_iterator
+FrozenHashMap<KeyType, ValueType, Hash, Equal>::begin() const {
+    return entries_.begin();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+typename FrozenHashMap<KeyType, ValueType, Hash, Equal>::const_iterator
+FrozenHashMap<KeyType, ValueType, Hash, Equal>::end() const {
+    return entries_.end();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+typename FrozenHashMap<KeyType, ValueType, Hash, Equal>::const_iterator
+FrozenHashMap<KeyType, ValueType, Hash, Equal>::find(const KeyType& key) const {
+    return find_key(key);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+bool FrozenHashMap<KeyType, ValueType, Hash, Equal>::contains(const KeyType& key) const {
+    return find_key(key) != end();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+size_t FrozenHashMap<KeyType, ValueType, Hash, Equal>::count(const KeyType& key) const {
+    return contains(key) ? 1 : 0;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+const ValueType& FrozenHashMap<KeyType, ValueType, Hash, Equal>::at(const KeyType& key) const {
+    const_iterator it = find_key(key);
+    if (it == end()) {
+        throw std::out_of_range("no such key in FrozenHashMap");
+    }
+    return it->second;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+template <class K>
+auto FrozenHashMap<KeyType, ValueType, Hash, Equal>::find(const K& key) const
+    -> EnableIfTransparent<K, const_iterator> {
+    return find_key(key);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+template <class K>
+auto FrozenHashMap<KeyType, ValueType, Hash, Equal>::contains(const K& key) const -> EnableIfTransparent<K, bool> {
+    return find_key(key) != end();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+template <class K>
+auto FrozenHashMap<KeyType, ValueType, Hash, Equal>::count(const K& key) const -> EnableIfTransparent<K, size_t> {
+    return find_key(key) != end() ? 1 : 0;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+size_t FrozenHashMap<KeyType, ValueType, Hash, Equal>::memory_usage() const {
+    return entries_.capacity() * sizeof(value_type) + pilots_.capacity() * sizeof(uint32_t) +
+           remap_.capacity() * sizeof(size_t) + overflow_.capacity() * sizeof(std::pair<uint64_t, size_t>);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+template <class Map>
+void FrozenHashMap<KeyType, ValueType, Hash, Equal>::build(const Map& map) {
+    std::vector<const value_type*> elements;
+    elements.reserve(map.size());
+    for (const value_type& element : map) {
+        elements.push_back(&element);
+    }
+    if (elements.empty()) {
+        return;
+    }
+
+    // Distinct keys with equal hashes land in the same bucket and follow the same positions
+    // for every pilot and seed, so only the first key of each hash gets placed.
+    std::vector<uint64_t> raw(elements.size());
+    std::vector<std::pair<uint64_t, size_t>> by_hash(elements.size());
+    for (size_t i = 0; i < elements.size(); ++i) {
+        raw[i] = static_cast<uint64_t>(hasher_(elements[i]->first));
+        by_hash[i] = {raw[i], i};
+    }
+    std::sort(by_hash.begin(), by_hash.end());
+    std::vector<size_t> hashed;
+    std::vector<size_t> overflow;
+    hashed.reserve(elements.size());
+    for (size_t i = 0; i < by_hash.size(); ++i) {
+        if (i > 0 && by_hash[i].first == by_hash[i - 1].first) {
+            overflow.push_back(by_hash[i].second);
+        } else {
+            hashed.push_back(by_hash[i].second);
+        }
+    }
+    by_hash = {};
+
+    std::vector<uint64_t> hashes(hashed.size());
+    std::vector<size_t> position;
+    for (seed_ = 0; seed_ < kMaxSeeds; ++seed_) {
+        for (size_t i = 0; i < hashed.size(); ++i) {
+            hashes[i] = MurmurMix(raw[hashed[i]] ^ MurmurMix(seed_));
+        }
+        if (place(hashes, position)) {
+            break;
+        }
+    }
+    if (seed_ == kMaxSeeds) {
+        throw std::runtime_error("FrozenHashMap: no perfect hash found");
+    }
+
+    std::vector<size_t> order(hashed.size());
+    for (size_t i = 0; i < hashed.size(); ++i) {
+        order[position[i]] = hashed[i];
+    }
+    hashed_count_ = hashed.size();
+    entries_.reserve(elements.size());
+    for (size_t i : order) {
+        entries_.push_back(*elements[i]);
+    }
+    for (size_t i : overflow) {
+        overflow_.emplace_back(MurmurMix(raw[i] ^ MurmurMix(seed_)), entries_.size());
+        entries_.push_back(*elements[i]);
+    }
+    // Already sorted by raw hash, but the mixed hash orders differently.
+    std::sort(overflow_.begin(), overflow_.end());
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+bool FrozenHashMap<KeyType, ValueType, Hash, Equal>::place(const std::vector<uint64_t>& hashes,
+                                                          std::vector<size_t>& position) {
+    size_t n = hashes.size();
+    size_t table_size = n + n / kSlack + 1;
+    pilots_.assign(n / kBucketSize + 1, 0);
+    position.assign(n, 0);
+
+    // Keys grouped by bucket (counting sort), then buckets ordered from the largest down: big
+    // buckets are placed while most entries are still free, single keys fill the last gaps.
+    std::vector<size_t> bucket_begin(pilots_.size() + 1, 0);
+    for (uint64_t hash : hashes) {
+        ++bucket_begin[bucket_for_hash(hash) + 1];
+    }
+    size_t max_bucket_size = 0;
+    for (size_t bucket = 0; bucket < pilots_.size(); ++bucket) {
+        max_bucket_size = std::max(max_bucket_size, bucket_begin[bucket + 1]);
+        bucket_begin[bucket + 1] += bucket_begin[bucket];
+    }
+    std::vector<size_t> keys(n);
+    std::vector<size_t> fill(bucket_begin.begin(), bucket_begin.end() - 1);
+    for (size_t i = 0; i < n; ++i) {
+        keys[fill[bucket_for_hash(hashes[i])]++] = i;
+    }
+    // Counting sort again, by decreasing size.
+    std::vector<size_t> size_begin(max_bucket_size + 2, 0);
+    for (size_t bucket = 0; bucket < pilots_.size(); ++bucket) {
+        ++size_begin[max_bucket_size - (bucket_begin[bucket + 1] - bucket_begin[bucket]) + 1];
+    }
+    for (size_t i = 1; i < size_begin.size(); ++i) {
+        size_begin[i] += size_begin[i - 1];
+    }
+    std::vector<size_t> buckets(pilots_.size());
+    for (size_t bucket = 0; bucket < pilots_.size(); ++bucket) {
+        buckets[size_begin[max_bucket_size - (bucket_begin[bucket + 1] - bucket_begin[bucket])]++] = bucket;
+    }
+
+    std::vector<bool> taken(table_size, false);
+    std::vector<size_t> candidate(max_bucket_size);
+    for (size_t bucket : buckets) {
+        size_t begin = bucket_begin[bucket];
+        size_t size = bucket_begin[bucket + 1] - begin;
+        if (size == 0) {
+            break;
+        }
+        uint32_t pilot = 0;
+        for (; pilot < kMaxPilot; ++pilot) {
+            // Positions are claimed as they are found and released again if a later key of
+            // the bucket collides, which also catches collisions within the bucket.
+            size_t placed = 0;
+            for (; placed < size; ++placed) {
+                size_t pos = position_for_hash(hashes[keys[begin + placed]], pilot, table_size);
+                if (taken[pos]) {
+                    break;
+                }
+                taken[pos] = true;
+                candidate[placed] = pos;
+            }
+            if (placed == size) {
+                break;
+            }
+            for (size_t i = 0; i < placed; ++i) {
+                taken[candidate[i]] = false;
+            }
+        }
+        if (pilot == kMaxPilot) {
+            return false;
+        }
+        pilots_[bucket] = pilot;
+        for (size_t i = 0; i < size; ++i) {
+            position[keys[begin + i]] = candidate[i];
+        }
+    }
+
+    // As many positions past the end were taken as entries were left free; the i-th of the
+    // former is sent to the i-th of the latter.
+    remap_.assign(table_size - n, 0);
+    size_t free_entry = 0;
+    for (size_t pos = n; pos < table_size; ++pos) {
+        if (taken[pos]) {
+            while (taken[free_entry]) {
+                ++free_entry;
+            }
+            remap_[pos - n] = free_entry++;
+        }
+    }
+    for (size_t& pos : position) {
+        if (pos >= n) {
+            pos = remap_[pos - n];
+        }
+    }
+    return true;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+template <class K>
+typename FrozenHashMap<KeyType, ValueType, Hash, Equal>::const_iterator
+FrozenHashMap<KeyType, ValueType, Hash, Equal>::find_key(const K& key) const {
+    if (entries_.empty()) {
+        return end();
+    }
+    uint64_t hash = get_hash(key);
+    size_t pos = position_for_hash(hash, pilots_[bucket_for_hash(hash)], hashed_count_ + remap_.size());
+    if (pos >= hashed_count_) {
+        pos = remap_[pos - hashed_count_];
+    }
+    if (equal_(entries_[pos].first, key)) {
+        return entries_.begin() + pos;
+    }
+    return overflow_.empty() ? end() : find_overflow(key, hash);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+template <class K>
+typename FrozenHashMap<KeyType, ValueType, Hash, Equal>::const_iterator
+FrozenHashMap<KeyType, ValueType, Hash, Equal>::find_overflow(const K& key, uint64_t hash) const {
+    auto it = std::lower_bound(overflow_.begin(), overflow_.end(), std::make_pair(hash, size_t(0)));
+    for (; it != overflow_.end() && it->first == hash; ++it) {
+        if (equal_(entries_[it->second].first, key)) {
+            return entries_.begin() + it->second;
+        }
+    }
+    return end();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+template <class K>
+uint64_t FrozenHashMap<KeyType, ValueType, Hash, Equal>::get_hash(const K& key) const {
+    // The same mixing as build(), so that identity hashes of integers spread as well.
+    return MurmurMix(static_cast<uint64_t>(hasher_(key)) ^ MurmurMix(seed_));
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+size_t FrozenHashMap<KeyType, ValueType, Hash, Equal>::bucket_for_hash(uint64_t hash) const {
+    // Skewed as in PTHash: 60% of the keys go to the first 30% of the buckets, so the large
+    // buckets are many and get placed while the array is empty, and the rest are mostly small
+    // enough to fill the last free entries quickly. The split is decided by the low bits of
+    // hash and the bucket by the high bits, so the two are independent.
+    size_t dense = pilots_.size() * 3 / 10;
+    if (static_cast<uint32_t>(hash) < kDenseKeyShare) {
+        return static_cast<size_t>(MultiplyHigh(hash, dense));
+    }
+    return dense + static_cast<size_t>(MultiplyHigh(hash, pilots_.size() - dense));
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal>
+size_t FrozenHashMap<KeyType, ValueType, Hash, Equal>::position_for_hash(uint64_t hash, uint32_t pilot,
+                                                                         size_t count) {
+    // The bucket took the high bits of hash; the pilot rehashes all of them, so keys of one
+    // bucket move independently of each other as the pilot changes.
+    uint64_t moved = MurmurMix(hash ^ (static_cast<uint64_t>(pilot) * 0x9E3779B97F4A7C15ull));
+    return static_cast<size_t>(MultiplyHigh(moved, count));
+}
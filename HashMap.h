@@ -1,52 +1,778 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <exception>
 #include <list>
+#include <memory>
+#include <memory_resource>
 #include <initializer_list>
 #include <iterator>
+#include <new>
+#include <optional>
+#include <system_error>
+#include <thread>
 #include <vector>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 #include <algorithm>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "Hashers.h"
+
+// Lookup engine that walks hash_map_ one slot at a time, comparing full keys.
+struct LinearProbing {
+    static constexpr bool kUseControlBytes = false;
+};
+
+// Lookup engine that keeps a 1-byte control tag per slot (7 hash bits or kEmpty) and
+// compares a whole group of tags per step, so data_ is only touched on tag matches.
+// Erasure uses backward shifting, so no "deleted" state is needed.
+struct GroupProbing {
+    static constexpr bool kUseControlBytes = true;
+    static constexpr int8_t kEmpty = -128;
+#if defined(__AVX2__)
+    static constexpr size_t kGroupWidth = 32;
+#elif defined(__SSE2__)
+    static constexpr size_t kGroupWidth = 16;
+#else
+    static constexpr size_t kGroupWidth = 8;
+#endif
+
+    // Bit i of the result is set iff ctrl[i] == tag, for i < kGroupWidth.
+    static uint32_t Match(const int8_t* ctrl, int8_t tag);
+    static uint32_t MatchEmpty(const int8_t* ctrl);
+    static size_t LowestBit(uint32_t mask);
+};
+
+inline uint32_t GroupProbing::Match(const int8_t* ctrl, int8_t tag) {
+#if defined(__AVX2__)
+    __m256i group = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ctrl));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8(tag))));
+#elif defined(__SSE2__)
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag))));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; ++i) {
+        mask |= static_cast<uint32_t>(ctrl[i] == tag) << i;
+    }
+    return mask;
+#endif
+}
+
+inline uint32_t GroupProbing::MatchEmpty(const int8_t* ctrl) {
+#if defined(__AVX2__)
+    // kEmpty is the only control byte with the sign bit set.
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ctrl))));
+#elif defined(__SSE2__)
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))));
+#else
+    return Match(ctrl, kEmpty);
+#endif
+}
+
+inline size_t GroupProbing::LowestBit(uint32_t mask) {
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    size_t id = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++id;
+    }
+    return id;
+#endif
+}
+
+// Asks the CPU to start loading the cache line holding address; a no-op where unsupported.
+inline void Prefetch(const void* address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#elif defined(__SSE2__)
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#endif
+}
+
+// Growth policies own the bucket count of hash_map_ and reduce a hash to a home slot.
+// PowerOfTwoGrowthPolicy mixes the hash with a Fibonacci multiplier and keeps the top bits,
+// FastRangeGrowthPolicy uses Lemire's multiply-high reduction for arbitrary sizes and
+// PrimeGrowthPolicy keeps the original prime-sized table with a modulo reduction.
+class PowerOfTwoGrowthPolicy {
+public:
+    explicit PowerOfTwoGrowthPolicy(size_t min_bucket_count = 2);
+
+    size_t bucket_count() const;                            // NOLINT
+    size_t bucket_for_hash(size_t hash) const;              // NOLINT
+    size_t next_bucket(size_t pos, size_t step = 1) const;  // NOLINT
+
+private:
+    size_t mask_;
+    size_t shift_;
+};
+
+class FastRangeGrowthPolicy {
+public:
+    explicit FastRangeGrowthPolicy(size_t min_bucket_count = 2);
+
+    size_t bucket_count() const;                            // NOLINT
+    size_t bucket_for_hash(size_t hash) const;              // NOLINT
+    size_t next_bucket(size_t pos, size_t step = 1) const;  // NOLINT
+
+private:
+    size_t bucket_count_;
+};
+
+class PrimeGrowthPolicy {
+public:
+    explicit PrimeGrowthPolicy(size_t min_bucket_count = 2);
+
+    size_t bucket_count() const;                            // NOLINT
+    size_t bucket_for_hash(size_t hash) const;              // NOLINT
+    size_t next_bucket(size_t pos, size_t step = 1) const;  // NOLINT
+
+private:
+    static constexpr size_t kBucketCounts[] = {2,
+                                               5,
+                                               11,
+                                               23,
+                                               47,
+                                               97,
+                                               197,
+                                               397,
+                                               797,
+                                               1597,
+                                               3203,
+                                               6421,
+                                               12853,
+                                               25717,
+                                               51437,
+                                               102877,
+                                               205759,
+                                               411527,
+                                               823117,
+                                               1646237,
+                                               3292489,
+                                               6584983,
+                                               13169977,
+                                               26339969,
+                                               52679969,
+                                               105359939,
+                                               210719881,
+                                               421439783,
+                                               842879579,
+                                               1685759167,
+                                               3371518343,
+                                               6743036717,
+                                               13486073473,
+                                               26972146961,
+                                               53944293929,
+                                               107888587883,
+                                               215777175787,
+                                               431554351609,
+                                               863108703229,
+                                               1726217406467,
+                                               3452434812973,
+                                               6904869625999,
+                                               13809739252051,
+                                               27619478504183,
+                                               55238957008387,
+                                               110477914016779,
+                                               220955828033581,
+                                               441911656067171,
+                                               883823312134381,
+                                               1767646624268779,
+                                               3535293248537579,
+                                               7070586497075177,
+                                               14141172994150357,
+                                               28282345988300791,
+                                               56564691976601587,
+                                               113129383953203213,
+                                               226258767906406483,
+                                               452517535812813007,
+                                               905035071625626043,
+                                               1810070143251252131,
+                                               3620140286502504283,
+                                               7240280573005008577};
+
+    size_t bucket_count_;
+};
+
+inline PowerOfTwoGrowthPolicy::PowerOfTwoGrowthPolicy(size_t min_bucket_count) : mask_(1), shift_(63) {
+    while (mask_ + 1 < min_bucket_count) {
+        mask_ = (mask_ << 1) | 1;
+        --shift_;
+    }
+}
+
+inline size_t PowerOfTwoGrowthPolicy::bucket_count() const {
+    return mask_ + 1;
+}
+
+inline size_t PowerOfTwoGrowthPolicy::bucket_for_hash(size_t hash) const {
+    return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> shift_);
+}
+
+inline size_t PowerOfTwoGrowthPolicy::next_bucket(size_t pos, size_t step) const {
+    return (pos + step) & mask_;
+}
+
+inline FastRangeGrowthPolicy::FastRangeGrowthPolicy(size_t min_bucket_count)
+    : bucket_count_(std::max<size_t>(min_bucket_count, 2)) {
+}
+
+inline size_t FastRangeGrowthPolicy::bucket_count() const {
+    return bucket_count_;
+}
+
+inline size_t FastRangeGrowthPolicy::bucket_for_hash(size_t hash) const {
+    uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(MultiplyHigh(mixed, bucket_count_));
+}
+
+inline size_t FastRangeGrowthPolicy::next_bucket(size_t pos, size_t step) const {
+    pos += step;
+    return pos < bucket_count_ ? pos : pos % bucket_count_;
+}
+
+inline PrimeGrowthPolicy::PrimeGrowthPolicy(size_t min_bucket_count) {
+    size_t id = 0;
+    while (kBucketCounts[id] < min_bucket_count) {
+        ++id;
+    }
+    bucket_count_ = kBucketCounts[id];
+}
+
+inline size_t PrimeGrowthPolicy::bucket_count() const {
+    return bucket_count_;
+}
+
+inline size_t PrimeGrowthPolicy::bucket_for_hash(size_t hash) const {
+    return (hash * 30011 + 179) % bucket_count_;
+}
+
+inline size_t PrimeGrowthPolicy::next_bucket(size_t pos, size_t step) const {
+    pos += step;
+    return pos < bucket_count_ ? pos : pos % bucket_count_;
+}
+
+// Sequence of elements stored in fixed-size chunks, the data_ of HashMap with ChunkedStorage.
+// Growing it never relocates what is already stored: the first chunk grows geometrically like a
+// std::vector up to kChunkSize elements, and every later chunk is allocated with kChunkSize of
+// them, so one emplace_back moves at most a chunk's worth of elements, plus at times the array
+// of chunk pointers. Element i lives at chunks_[i >> kChunkShift][i & (kChunkSize - 1)].
+template <class T, class Allocator>
+class ChunkedVector {
+private:
+    using AllocatorTraits = std::allocator_traits<Allocator>;
+    using Pointer = typename AllocatorTraits::pointer;
+
+    static constexpr bool kNothrowMoveAssignable =
+        AllocatorTraits::propagate_on_container_move_assignment::value || AllocatorTraits::is_always_equal::value;
+
+public:
+    explicit ChunkedVector(const Allocator& allocator);
+    ChunkedVector(const ChunkedVector& other, const Allocator& allocator);
+    ChunkedVector(ChunkedVector&& other) noexcept;
+    // With allocators that neither propagate nor compare equal the elements are moved one by
+    // one, and other keeps its chunks.
+    ChunkedVector& operator=(ChunkedVector&& other) noexcept(kNothrowMoveAssignable);
+    ~ChunkedVector();
+
+    size_t size() const;              // NOLINT
+    bool empty() const;               // NOLINT
+    size_t capacity() const;          // NOLINT
+    Allocator get_allocator() const;  // NOLINT
+
+    T& operator[](size_t index);
+    const T& operator[](size_t index) const;
+    T& back();  // NOLINT
+    // Where element index lies, which may be one past the end of its chunk, or nullptr if no
+    // chunk covers it. Elements index - 1 and index are adjacent unless index starts a chunk.
+    T* address(size_t index);                // NOLINT
+    const T* address(size_t index) const;    // NOLINT
+    static bool starts_chunk(size_t index);  // NOLINT
+
+    template <class... Args>
+    void emplace_back(Args&&... args);  // NOLINT
+    void pop_back();                    // NOLINT
+    // Destroys the elements from index size on.
+    void truncate(size_t size);  // NOLINT
+    void clear();                // NOLINT
+    void reserve(size_t count);  // NOLINT
+    // Releases the chunks past the last element; a lone first chunk is cut down to size().
+    void shrink_to_fit();  // NOLINT
+    // As for standard containers, the allocators must compare equal unless they propagate on swap.
+    void swap(ChunkedVector& other);  // NOLINT
+
+private:
+    // Chunks of about 64 KiB, and of at least 4 elements.
+    static constexpr size_t kChunkShift = [] {
+        size_t shift = 2;
+        while (shift < 30 && (sizeof(T) << (shift + 1)) <= (1 << 16)) {
+            ++shift;
+        }
+        return shift;
+    }();
+    static constexpr size_t kChunkSize = static_cast<size_t>(1) << kChunkShift;
+
+    Allocator allocator_;
+    std::vector<Pointer, typename AllocatorTraits::template rebind_alloc<Pointer>> chunks_;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+
+    size_t chunk_capacity(size_t chunk) const;  // NOLINT
+    // Moves the elements into a new first chunk of the given capacity; it must be the only
+    // chunk, and capacity at least size(). construct_back(slot) may build an element at the
+    // slot past the moved ones before they are moved, so that its arguments may refer to them.
+    template <class ConstructBack>
+    void reallocate_first(size_t capacity, ConstructBack construct_back);  // NOLINT
+    void release();                                                        // NOLINT
+};
+
+template <class T, class Allocator>
+ChunkedVector<T, Allocator>::ChunkedVector(const Allocator& allocator) : allocator_(allocator), chunks_(allocator) {
+}
+
+template <class T, class Allocator>
+ChunkedVector<T, Allocator>::ChunkedVector(const ChunkedVector& other, const Allocator& allocator)
+    : ChunkedVector(allocator) {
+    reserve(other.size_);
+    for (size_t index = 0; index < other.size_; ++index) {
+        emplace_back(other[index]);
+    }
+}
+
+template <class T, class Allocator>
+ChunkedVector<T, Allocator>::ChunkedVector(ChunkedVector&& other) noexcept
+    : allocator_(other.allocator_),
+      chunks_(std::move(other.chunks_)),
+      size_(other.size_),
+      capacity_(other.capacity_) {
+    other.chunks_.clear();
+    other.size_ = 0;
+    other.capacity_ = 0;
+}
+
+template <class T, class Allocator>
+ChunkedVector<T, Allocator>& ChunkedVector<T, Allocator>::operator=(ChunkedVector&& other) noexcept(
+    kNothrowMoveAssignable) {
+    if (this == &other) {
+        return (*this);
+    }
+    if (AllocatorTraits::propagate_on_container_move_assignment::value || allocator_ == other.allocator_) {
+        release();
+        if constexpr (AllocatorTraits::propagate_on_container_move_assignment::value) {
+            allocator_ = other.allocator_;
+        }
+        chunks_ = std::move(other.chunks_);
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        other.chunks_.clear();
+        other.size_ = 0;
+        other.capacity_ = 0;
+    } else {
+        clear();
+        reserve(other.size_);
+        for (size_t index = 0; index < other.size_; ++index) {
+            emplace_back(std::move(other[index]));
+        }
+    }
+    return (*this);
+}
+
+template <class T, class Allocator>
+ChunkedVector<T, Allocator>::~ChunkedVector() {
+    release();
+}
+
+template <class T, class Allocator>
+size_t ChunkedVector<T, Allocator>::size() const {
+    return size_;
+}
+
+template <class T, class Allocator>
+bool ChunkedVector<T, Allocator>::empty() const {
+    return size_ == 0;
+}
+
+template <class T, class Allocator>
+size_t ChunkedVector<T, Allocator>::capacity() const {
+    return capacity_;
+}
+
+template <class T, class Allocator>
+Allocator ChunkedVector<T, Allocator>::get_allocator() const {
+    return allocator_;
+}
+
+template <class T, class Allocator>
+inline T& ChunkedVector<T, Allocator>::operator[](size_t index) {
+    return chunks_[index >> kChunkShift][index & (kChunkSize - 1)];
+}
+
+template <class T, class Allocator>
+inline const T& ChunkedVector<T, Allocator>::operator[](size_t index) const {
+    return chunks_[index >> kChunkShift][index & (kChunkSize - 1)];
+}
+
+template <class T, class Allocator>
+T& ChunkedVector<T, Allocator>::back() {
+    return (*this)[size_ - 1];
+}
+
+template <class T, class Allocator>
+T* ChunkedVector<T, Allocator>::address(size_t index) {
+    size_t chunk = index >> kChunkShift;
+    return chunk < chunks_.size() ? &*chunks_[chunk] + (index & (kChunkSize - 1)) : nullptr;
+}
+
+template <class T, class Allocator>
+const T* ChunkedVector<T, Allocator>::address(size_t index) const {
+    size_t chunk = index >> kChunkShift;
+    return chunk < chunks_.size() ? &*chunks_[chunk] + (index & (kChunkSize - 1)) : nullptr;
+}
+
+template <class T, class Allocator>
+bool ChunkedVector<T, Allocator>::starts_chunk(size_t index) {
+    return (index & (kChunkSize - 1)) == 0;
+}
+
+template <class T, class Allocator>
+template <class... Args>
+void ChunkedVector<T, Allocator>::emplace_back(Args&&... args) {
+    if (size_ == capacity_) {
+        if (capacity_ < kChunkSize) {
+            reallocate_first(std::min(std::max<size_t>(2 * capacity_, 1), kChunkSize), [this, &args...](T* slot) {
+                AllocatorTraits::construct(allocator_, slot, std::forward<Args>(args)...);
+            });
+            ++size_;
+            return;
+        }
+        Pointer chunk = AllocatorTraits::allocate(allocator_, kChunkSize);
+        try {
+            chunks_.push_back(chunk);
+        } catch (...) {
+            AllocatorTraits::deallocate(allocator_, chunk, kChunkSize);
+            throw;
+        }
+        capacity_ += kChunkSize;
+    }
+    AllocatorTraits::construct(allocator_, std::addressof((*this)[size_]), std::forward<Args>(args)...);
+    ++size_;
+}
+
+template <class T, class Allocator>
+void ChunkedVector<T, Allocator>::pop_back() {
+    --size_;
+    AllocatorTraits::destroy(allocator_, std::addressof((*this)[size_]));
+}
 
-template <class KeyType, class ValueType, class Hash = std::hash<KeyType>>
+template <class T, class Allocator>
+void ChunkedVector<T, Allocator>::truncate(size_t size) {
+    while (size_ > size) {
+        pop_back();
+    }
+}
+
+template <class T, class Allocator>
+void ChunkedVector<T, Allocator>::clear() {
+    truncate(0);
+}
+
+template <class T, class Allocator>
+void ChunkedVector<T, Allocator>::reserve(size_t count) {
+    if (count <= capacity_) {
+        return;
+    }
+    if (capacity_ < kChunkSize) {
+        reallocate_first(std::min(count, kChunkSize), [](T*) {});
+    }
+    chunks_.reserve((count + kChunkSize - 1) >> kChunkShift);
+    while (capacity_ < count) {
+        chunks_.push_back(AllocatorTraits::allocate(allocator_, kChunkSize));
+        capacity_ += kChunkSize;
+    }
+}
+
+template <class T, class Allocator>
+void ChunkedVector<T, Allocator>::shrink_to_fit() {
+    if (size_ == 0) {
+        release();
+        chunks_.shrink_to_fit();
+        return;
+    }
+    size_t used = (size_ + kChunkSize - 1) >> kChunkShift;
+    while (chunks_.size() > used) {
+        AllocatorTraits::deallocate(allocator_, chunks_.back(), kChunkSize);
+        chunks_.pop_back();
+        capacity_ -= kChunkSize;
+    }
+    if (chunks_.size() == 1 && capacity_ > size_) {
+        reallocate_first(size_, [](T*) {});
+    }
+    chunks_.shrink_to_fit();
+}
+
+template <class T, class Allocator>
+void ChunkedVector<T, Allocator>::swap(ChunkedVector& other) {
+    if constexpr (AllocatorTraits::propagate_on_container_swap::value) {
+        std::swap(allocator_, other.allocator_);
+    }
+    chunks_.swap(other.chunks_);
+    std::swap(size_, other.size_);
+    std::swap(capacity_, other.capacity_);
+}
+
+template <class T, class Allocator>
+size_t ChunkedVector<T, Allocator>::chunk_capacity(size_t chunk) const {
+    return chunk == 0 && chunks_.size() == 1 ? capacity_ : kChunkSize;
+}
+
+template <class T, class Allocator>
+template <class ConstructBack>
+void ChunkedVector<T, Allocator>::reallocate_first(size_t capacity, ConstructBack construct_back) {
+    if (chunks_.empty()) {
+        chunks_.reserve(1);
+    }
+    Pointer chunk = AllocatorTraits::allocate(allocator_, capacity);
+    size_t moved = 0;
+    bool constructed_back = false;
+    try {
+        if (size_ < capacity) {
+            construct_back(std::addressof(chunk[size_]));
+            constructed_back = true;
+        }
+        for (; moved < size_; ++moved) {
+            AllocatorTraits::construct(allocator_, std::addressof(chunk[moved]), std::move_if_noexcept((*this)[moved]));
+        }
+    } catch (...) {
+        for (size_t index = 0; index < moved; ++index) {
+            AllocatorTraits::destroy(allocator_, std::addressof(chunk[index]));
+        }
+        if (constructed_back) {
+            AllocatorTraits::destroy(allocator_, std::addressof(chunk[size_]));
+        }
+        AllocatorTraits::deallocate(allocator_, chunk, capacity);
+        throw;
+    }
+    if (chunks_.empty()) {
+        chunks_.push_back(chunk);
+    } else {
+        for (size_t index = 0; index < size_; ++index) {
+            AllocatorTraits::destroy(allocator_, std::addressof((*this)[index]));
+        }
+        AllocatorTraits::deallocate(allocator_, chunks_[0], capacity_);
+        chunks_[0] = chunk;
+    }
+    capacity_ = capacity;
+}
+
+template <class T, class Allocator>
+void ChunkedVector<T, Allocator>::release() {
+    clear();
+    for (size_t chunk = 0; chunk < chunks_.size(); ++chunk) {
+        AllocatorTraits::deallocate(allocator_, chunks_[chunk], chunk_capacity(chunk));
+    }
+    chunks_.clear();
+    capacity_ = 0;
+}
+
+// Storage policies choose the container of data_, the array of nodes. ContiguousStorage keeps
+// them in one std::vector, so a node is reached with a single index and iteration is a linear
+// scan, but growing data_ moves every node at once. ChunkedStorage keeps them in a
+// ChunkedVector, which never relocates stored nodes and so bounds the work of any single insert,
+// at the price of an extra indirection on every access; it is meant for incremental rehashing.
+struct ContiguousStorage {
+    static constexpr bool kChunked = false;
+    template <class T, class Allocator>
+    using Container = std::vector<T, Allocator>;
+};
+
+struct ChunkedStorage {
+    static constexpr bool kChunked = true;
+    template <class T, class Allocator>
+    using Container = ChunkedVector<T, Allocator>;
+};
+
+// Holds when both Hash and Equal declare is_transparent, i.e. accept a lookup key of type K
+// (e.g. std::string_view for std::string keys) without converting it to the key type first.
+template <class Hash, class Equal, class K, class = void>
+struct IsTransparentLookup : std::false_type {};
+
+template <class Hash, class Equal, class K>
+struct IsTransparentLookup<Hash, Equal, K, std::void_t<typename Hash::is_transparent, typename Equal::is_transparent>>
+    : std::true_type {};
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+class MappedHashMap;
+
+// All storage (the bucket arrays and data_) is allocated through Allocator, rebound to the
+// respective element type.
+template <class KeyType, class ValueType, class Hash = std::hash<KeyType>, class Equal = std::equal_to<KeyType>,
+          class ProbingPolicy = LinearProbing, class GrowthPolicy = PowerOfTwoGrowthPolicy,
+          class Allocator = std::allocator<std::pair<const KeyType, ValueType>>,
+          class StoragePolicy = ContiguousStorage>
 class HashMap {
 private:
+    using AllocatorTraits = std::allocator_traits<Allocator>;
+    template <class T>
+    using Vector = std::vector<T, typename AllocatorTraits::template rebind_alloc<T>>;
+
+    // Moves only steal the arrays, so they throw only if moving Hash or Equal can, or if move
+    // assignment has to move the elements one by one into memory of a different allocator.
+    static constexpr bool kNothrowMoveConstructible =
+        std::is_nothrow_move_constructible_v<Hash> && std::is_nothrow_move_constructible_v<Equal>;
+    static constexpr bool kNothrowMoveAssignable =
+        (AllocatorTraits::propagate_on_container_move_assignment::value || AllocatorTraits::is_always_equal::value) &&
+        std::is_nothrow_move_assignable_v<Hash> && std::is_nothrow_move_assignable_v<Equal>;
+
+    // Writes the on-disk image straight from the slot array.
+    template <class, class, class, class>
+    friend class MappedHashMap;
+
+    template <class K, class Result>
+    using EnableIfTransparent = std::enable_if_t<IsTransparentLookup<Hash, Equal, K>::value, Result>;
+
     struct Node {
-        std::pair<const KeyType, ValueType> x_;
-        size_t psl;
+        // The key is stored mutable so that erase can relocate the last node of data_ into
+        // the freed place by assignment, and reallocation of data_ can move keys instead of
+        // copying them; outside Node it is only seen through value().
+        //
+        // value() views x_ as std::pair<const KeyType, ValueType> through std::launder. Strictly
+        // that is undefined behaviour, since no such pair object lives there, but the two types
+        // differ only in the const of the first member and have the same layout; libc++'s
+        // std::map (__value_type) and abseil's map_slot_policy pun the same pair types the same
+        // way. The alternative, storing the const pair, would make every reallocation of data_
+        // copy the keys, and in C++17 rebuilding a const member in place needs std::launder too.
+        std::pair<KeyType, ValueType> x_;
 
         Node();
-        Node(const Node& other);
-        explicit Node(const std::pair<const KeyType, ValueType> x);
-        Node& operator=(const Node& other);
+        template <class... Args>
+        explicit Node(Args&&... args);
+
+        std::pair<const KeyType, ValueType>& value();
+        const std::pair<const KeyType, ValueType>& value() const;
+    };
+    static_assert(sizeof(std::pair<KeyType, ValueType>) == sizeof(std::pair<const KeyType, ValueType>) &&
+                      alignof(std::pair<KeyType, ValueType>) == alignof(std::pair<const KeyType, ValueType>),
+                  "Node::value() relies on std::pair<K, V> and std::pair<const K, V> sharing a layout");
+
+    using NodeVector =
+        typename StoragePolicy::template Container<Node, typename AllocatorTraits::template rebind_alloc<Node>>;
+
+    // Where an iterator stands. With ContiguousStorage the node alone; with ChunkedStorage also
+    // the container and the index, to find the next chunk once the walk leaves the current one.
+    // NodeT and NodeVectorT are const for const_iterator.
+    template <class NodeT, class NodeVectorT>
+    struct ContiguousCursor {
+        ContiguousCursor() = default;
+        ContiguousCursor(NodeVectorT* container, size_t index);
+        void next();  // NOLINT
+
+        NodeT* node;
+    };
+
+    template <class NodeT, class NodeVectorT>
+    struct ChunkedCursor {
+        ChunkedCursor() = default;
+        ChunkedCursor(NodeVectorT* container, size_t index);
+        void next();  // NOLINT
+
+        NodeVectorT* nodes;
+        size_t id;
+        NodeT* node;
+    };
+
+    template <class NodeT, class NodeVectorT>
+    using Cursor = std::conditional_t<StoragePolicy::kChunked, ChunkedCursor<NodeT, NodeVectorT>,
+                                      ContiguousCursor<NodeT, NodeVectorT>>;
+
+    // A hash_map_ cell referring to data_[id], or kEmptySlot. Slots hold 32-bit indices rather
+    // than pointers, so a slot takes 8 bytes and stays valid when erase moves a node. The probe
+    // sequence length and an 8-bit fingerprint of the hash share the second word: a key can only
+    // sit in a slot whose psl equals its own probe distance, so together they reject almost all
+    // mismatches without touching data_. 24 bits of psl outlast any table with a usable hash.
+    struct Slot {
+        uint32_t id;
+        uint32_t psl : 24;
+        uint32_t fingerprint : 8;
+    };
+
+    static constexpr uint32_t kEmptySlot = static_cast<uint32_t>(-1);
+    // The largest psl the 24-bit field holds. A slot is never more than bucket_count() - 1 away
+    // from home, so only tables of more than 2^24 buckets whose hash piles millions of keys into
+    // one cluster could exceed it.
+    static constexpr uint32_t kMaxPsl = (static_cast<uint32_t>(1) << 24) - 1;
+
+    // A Table without slots is unallocated: hash_map_ is in that state in a map that is
+    // default-constructed or moved from, and gets its slots on the first insert. Lookups in it
+    // miss without probing.
+    struct Table {
+        explicit Table(const Allocator& allocator);
+        Table(const Table& other, const Allocator& allocator);
+
+        Vector<Slot> slots;
+        // Control tags of slots, used only by GroupProbing. The first kGroupWidth - 1 tags are
+        // mirrored past the end so that a group can be loaded at any slot.
+        Vector<int8_t> ctrl;
+        GrowthPolicy growth;
     };
 
 public:
+    using allocator_type = Allocator;
+
     explicit HashMap();
     template <class Iterator>
     HashMap(Iterator begin, Iterator end);
     HashMap(std::initializer_list<std::pair<KeyType, ValueType>> list);
-    explicit HashMap(Hash hasher);
+    explicit HashMap(const Allocator& allocator);
+    explicit HashMap(Hash hasher, Equal equal = Equal(), const Allocator& allocator = Allocator());
     template <class Iterator>
-    HashMap(Iterator begin, Iterator end, Hash hasher);
-    HashMap(std::initializer_list<std::pair<KeyType, ValueType>> list, Hash hasher);
+    HashMap(Iterator begin, Iterator end, Hash hasher, Equal equal = Equal(), const Allocator& allocator = Allocator());
+    HashMap(std::initializer_list<std::pair<KeyType, ValueType>> list, Hash hasher, Equal equal = Equal(),
+            const Allocator& allocator = Allocator());
     HashMap(const HashMap& other);
+    HashMap(const HashMap& other, const Allocator& allocator);
+    // Leave other empty and without any allocated memory.
+    HashMap(HashMap&& other) noexcept(kNothrowMoveConstructible);
 
     size_t size() const;  // NOLINT
 
     bool empty() const;  // NOLINT
 
-    Hash hash_function() const;  // NOLINT
+    Hash hash_function() const;       // NOLINT
+    Equal key_eq() const;             // NOLINT
+    Allocator get_allocator() const;  // NOLINT
 
-    void insert(const std::pair<KeyType, ValueType> x);  // NOLINT
-
-    void erase(const KeyType v);  // NOLINT
+    // Returns the number of erased elements, i.e. 0 or 1.
+    size_t erase(const KeyType& v);  // NOLINT
+    template <class K>
+    auto erase(const K& v) -> EnableIfTransparent<K, size_t>;  // NOLINT
 
     HashMap& operator= (const HashMap& other);
+    HashMap& operator= (HashMap&& other) noexcept(kNothrowMoveAssignable);
+
+    // As for standard containers, the allocators must compare equal unless they propagate on
+    // swap. Copy assignment keeps this map's allocator unless it propagates on copy assignment.
+    void swap(HashMap& other);  // NOLINT
 
     class const_iterator {  // NOLINT
     public:
         const_iterator();
         const_iterator(const const_iterator& it);
-        explicit const_iterator(typename std::vector<std::pair<size_t, Node*>*>::const_iterator begin, size_t id);
+        const_iterator& operator=(const const_iterator& it);
+        explicit const_iterator(const NodeVector* nodes, size_t id);
 
         const std::pair<const KeyType, ValueType>& operator*() const;
         const std::pair<const KeyType, ValueType>* operator->() const;
@@ -58,15 +784,15 @@ public:
         bool operator!=(const const_iterator& other) const;
 
     private:
-        typename std::vector<std::pair<size_t, Node*>*>::const_iterator begin_;
-        size_t it_;
+        Cursor<const Node, const NodeVector> cursor_;
     };
 
     class iterator {  // NOLINT
     public:
         iterator();
         iterator(const iterator& it);
-        explicit iterator(typename std::vector<std::pair<size_t, Node*>*>::iterator begin, size_t id);
+        iterator& operator=(const iterator& it);
+        explicit iterator(NodeVector* nodes, size_t id);
 
         std::pair<const KeyType, ValueType>& operator*() const;
         std::pair<const KeyType, ValueType>* operator->() const;
@@ -78,8 +804,7 @@ public:
         bool operator!=(const iterator& other) const;
 
     private:
-        typename std::vector<std::pair<size_t, Node*>*>::iterator begin_;
-        size_t it_;
+        Cursor<Node, NodeVector> cursor_;
     };
 
     const_iterator begin() const;  // NOLINT
@@ -87,410 +812,1168 @@ public:
     iterator begin();              // NOLINT
     iterator end();                // NOLINT
 
-    iterator find(KeyType v);              // NOLINT
-    const_iterator find(KeyType v) const;  // NOLINT
-
-    ValueType& operator[](const KeyType v);
-    const ValueType& at(const KeyType v) const;  // NOLINT
+    iterator find(const KeyType& v);              // NOLINT
+    const_iterator find(const KeyType& v) const;  // NOLINT
+    // The templated find, contains, count and erase take part in overload resolution only if
+    // Hash and Equal are transparent; the key is then hashed and compared without conversion.
+    template <class K>
+    auto find(const K& v) -> EnableIfTransparent<K, iterator>;  // NOLINT
+    template <class K>
+    auto find(const K& v) const -> EnableIfTransparent<K, const_iterator>;  // NOLINT
+
+    bool contains(const KeyType& v) const;  // NOLINT
+    template <class K>
+    auto contains(const K& v) const -> EnableIfTransparent<K, bool>;  // NOLINT
+
+    size_t count(const KeyType& v) const;  // NOLINT
+    template <class K>
+    auto count(const K& v) const -> EnableIfTransparent<K, size_t>;  // NOLINT
+
+    // Batched lookups write one result per key of [first, last) to out, in order. While a key
+    // is resolved, the key kPrefetchDistance positions ahead is already hashed and its home slot
+    // prefetched, so the cache misses of independent keys overlap instead of being paid one
+    // after another.
+    template <class ForwardIt, class OutputIt>
+    void find_batch(ForwardIt first, ForwardIt last, OutputIt out);  // NOLINT
+    template <class ForwardIt, class OutputIt>
+    void find_batch(ForwardIt first, ForwardIt last, OutputIt out) const;  // NOLINT
+    template <class ForwardIt, class OutputIt>
+    void contains_batch(ForwardIt first, ForwardIt last, OutputIt out) const;  // NOLINT
+
+    std::pair<iterator, bool> insert(const std::pair<KeyType, ValueType>& x);  // NOLINT
+    std::pair<iterator, bool> insert(std::pair<KeyType, ValueType>&& x);       // NOLINT
+    // Inserts a range of pairs with the same prefetching as find_batch; returns how many were new.
+    template <class ForwardIt>
+    size_t insert_batch(ForwardIt first, ForwardIt last);  // NOLINT
+    // Inserts a range of pairs; of equal keys the first one wins. A forward range is counted
+    // first, the table is sized for all of it at once and the pairs go through insert_batch.
+    template <class InputIt>
+    void insert(InputIt first, InputIt last);  // NOLINT
+
+    // Constructs the pair from args in place; it is destroyed again if the key is already present.
+    template <class... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);  // NOLINT
+
+    // Constructs the value from args only if the key is absent; otherwise args are left untouched.
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(const KeyType& key, Args&&... args);  // NOLINT
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(KeyType&& key, Args&&... args);  // NOLINT
+
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(const KeyType& key, M&& obj);  // NOLINT
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(KeyType&& key, M&& obj);  // NOLINT
+
+    ValueType& operator[](const KeyType& v);
+    ValueType& operator[](KeyType&& v);
+    const ValueType& at(const KeyType& v) const;  // NOLINT
 
     void clear();  // NOLINT
 
+    // Removes every element for which pred(const std::pair<const KeyType, ValueType>&) holds and
+    // returns how many were removed. data_ is compacted in one pass and hash_map_ is swept once,
+    // shifting the remaining slots back towards their home buckets, instead of a backward shift
+    // per erased key. A pending incremental rehash is finished first. If pred throws, the map is
+    // left unchanged.
+    template <class Pred>
+    size_t erase_if(Pred pred);  // NOLINT
+
+    // Calls fn(element) for every element. data_ is split into contiguous chunks run on up to
+    // thread_count threads (0 means std::thread::hardware_concurrency()), the calling thread
+    // taking the first one; small maps run on fewer threads. fn may modify the values through
+    // the non-const overload, must be safe to call concurrently on different elements and must
+    // not modify the map. The first exception thrown by fn is rethrown once all chunks are done.
+    template <class Fn>
+    void parallel_for_each(Fn fn, size_t thread_count = 0);  // NOLINT
+    template <class Fn>
+    void parallel_for_each(Fn fn, size_t thread_count = 0) const;  // NOLINT
+
+    // Like std::transform_reduce: folds transform(element) of every element into init with
+    // reduce, in unspecified order and grouping, so reduce must be associative and commutative.
+    // Threads and exceptions are handled as in parallel_for_each.
+    template <class T, class Reduce, class Transform>
+    T parallel_reduce(T init, Reduce reduce, Transform transform, size_t thread_count = 0) const;  // NOLINT
+
+    // Rebuilds the table with the smallest bucket count that fits size() and releases
+    // the spare capacity of all internal arrays.
+    void shrink_to_fit();  // NOLINT
+
+    size_t bucket_count() const;  // NOLINT
+    float load_factor() const;    // NOLINT
+
+    // The table grows once size() would exceed max_load_factor() * bucket_count(). Lower
+    // values keep probe sequences short at the cost of empty slots; Robin Hood placement keeps
+    // lookups fast up to about 0.9. Must lie in (0, 1), otherwise std::invalid_argument is
+    // thrown. Rebuilds the table right away if the current size no longer fits.
+    float max_load_factor() const;                // NOLINT
+    void max_load_factor(float max_load_factor);  // NOLINT
+
+    // Rebuilds the table with at least bucket_count buckets, and at least as many as size()
+    // needs under max_load_factor().
+    void rehash(size_t bucket_count);  // NOLINT
+    // Sizes the table so that count elements fit without another rebuild.
+    void reserve(size_t count);  // NOLINT
+
+    // Bytes allocated by the table itself, by array: hash_map is the bucket array with its
+    // control bytes, rehash the arrays of an incremental rehash (the old bucket array being
+    // drained and the new one being prepared), zero outside incremental mode. Heap memory owned
+    // by keys and values (e.g. string contents) is not counted.
+    struct MemoryUsage {
+        size_t hash_map;
+        size_t rehash;
+        size_t data;
+
+        size_t total() const;  // NOLINT
+    };
+
+    MemoryUsage memory_usage() const;  // NOLINT
+
+#if defined(HASHMAP_ENABLE_STATS)
+    // Probe and rebuild statistics, only available when compiled with HASHMAP_ENABLE_STATS;
+    // without it the map keeps no counters and lookups do no extra work. The macro changes the
+    // layout of HashMap, so it must be the same in every translation unit of a program.
+    //
+    // Every lookup by key counts, including the ones insert, erase and operator[] do to check
+    // for an existing key. A probe is one slot for LinearProbing and one group of control bytes
+    // for GroupProbing. During an incremental rehash a key missing from the new bucket array is
+    // looked up again in the old one, which counts as a second lookup.
+    struct Stats {
+        // psl_histogram[d] is the number of elements d slots away from their home bucket.
+        std::vector<size_t> psl_histogram;
+        uint32_t max_psl;
+        float load_factor;
+        // Allocated but unused bytes of data_. Erase moves the last node into the hole, so
+        // these all lie past the last node; there are no tombstones.
+        size_t unused_data_bytes;
+
+        // Lookups that found their key and lookups that did not, with the probes they took.
+        size_t hits;
+        size_t hit_probes;
+        size_t misses;
+        size_t miss_probes;
+
+        // Full rebuilds and incremental migrations, and the time spent in them, including the
+        // migration steps run by inserts and erases.
+        size_t rehash_count;
+        std::chrono::nanoseconds rehash_time;
+
+        double average_hit_probes() const;   // NOLINT
+        double average_miss_probes() const;  // NOLINT
+    };
+
+    // The probe histogram is computed on the call, in time linear in bucket_count().
+    Stats stats() const;  // NOLINT
+    // Zeroes the lookup and rehash counters. Copies of a map start with zeroed counters.
+    void reset_stats();  // NOLINT
+#endif
+
+    // Writes an image of the table to path that MappedHashMap maps and serves lookups from
+    // without rebuilding it. Keys and values must be trivially copyable or std::string, and
+    // the caller must include MappedHashMap.h. The image is written and synced to path + ".tmp"
+    // first and then renamed to path, so MappedHashMaps open on an older image at path keep
+    // reading it. Throws std::runtime_error on I/O errors.
+    void save(const std::string& path) const;  // NOLINT
+
+    // In incremental mode growing the table does not rehash it in one go. The new bucket array
+    // is filled with empty slots a step per insert and erase while the old one nears its load
+    // limit; after the switch the old array stays alive, every insert and erase migrates a
+    // share of its slots into the new one, and lookups consult both arrays until the migration
+    // is over. The shares depend on max_load_factor() but not on size(). With ChunkedStorage the
+    // nodes are never relocated as a whole either, so no single insert or erase costs time
+    // linear in the size of the map; with ContiguousStorage data_ still grows like a
+    // std::vector, moving every node at once.
+    bool incremental_rehash() const;        // NOLINT
+    void incremental_rehash(bool enabled);  // NOLINT
+
 private:
-    size_t initial_bucket_count_ = 1;
+    static constexpr size_t kMigrationStep = 64;
+    // Fewest empty slots appended to next_hash_map_ per step; its preparation starts once this
+    // many per remaining insert are enough to finish it before hash_map_ has to grow.
+    static constexpr size_t kPrepareStep = 256;
+    static constexpr size_t kPrefetchDistance = 16;
+    // clear() rehashes the keys to find their slots only when the table has more than this
+    // many buckets per element; otherwise wiping the whole bucket array is cheaper.
+    static constexpr size_t kSparseRatio = 8;
+    // The parallel scans give every thread at least this many elements.
+    static constexpr size_t kParallelGrain = 1 << 14;
+
     double max_load_factor_ = 0.25;
-    std::vector<size_t> bucket_counts_ = {2,
-                                          5,
-                                          11,
-                                          23,
-                                          47,
-                                          97,
-                                          197,
-                                          397,
-                                          797,
-                                          1597,
-                                          3203,
-                                          6421,
-                                          12853,
-                                          25717,
-                                          51437,
-                                          102877,
-                                          205759,
-                                          411527,
-                                          823117,
-                                          1646237,
-                                          3292489,
-                                          6584983,
-                                          13169977,
-                                          26339969,
-                                          52679969,
-                                          105359939,
-                                          210719881,
-                                          421439783,
-                                          842879579,
-                                          1685759167,
-                                          3371518343,
-                                          6743036717,
-                                          13486073473,
-                                          26972146961,
-                                          53944293929,
-                                          107888587883,
-                                          215777175787,
-                                          431554351609,
-                                          863108703229,
-                                          1726217406467,
-                                          3452434812973,
-                                          6904869625999,
-                                          13809739252051,
-                                          27619478504183,
-                                          55238957008387,
-                                          110477914016779,
-                                          220955828033581,
-                                          441911656067171,
-                                          883823312134381,
-                                          1767646624268779,
-                                          3535293248537579,
-                                          7070586497075177,
-                                          14141172994150357,
-                                          28282345988300791,
-                                          56564691976601587,
-                                          113129383953203213,
-                                          226258767906406483,
-                                          452517535812813007,
-                                          905035071625626043,
-                                          1810070143251252131,
-                                          3620140286502504283,
-                                          7240280573005008577};
+    bool incremental_rehash_ = false;
 
     Hash hasher_;
-    std::vector<std::pair<size_t, Node*>*> all_elements_;
-    std::vector<Node> data_;
-    std::vector<std::pair<size_t, Node*>> hash_map_;
-
-    void Build();
+    Equal equal_;
+    NodeVector data_;
+    Table hash_map_;
+    // The table being drained into hash_map_ during an incremental rehash, empty otherwise.
+    // Its slots are migrated in cyclic order starting from the empty slot migrate_start_,
+    // and migrated_ of them have been moved so far.
+    Table old_hash_map_;
+    size_t migrate_start_ = 0;
+    size_t migrated_ = 0;
+    // In incremental mode, the table hash_map_ grows into next. Once hash_map_ nears its load
+    // limit, the array is reserved and filled with empty slots a step per insert and erase, so
+    // it is complete when the migration begins; it has no slots otherwise.
+    Table next_hash_map_;
+
+#if defined(HASHMAP_ENABLE_STATS)
+    // Relaxed atomics, since const lookups may run concurrently, e.g. under the shared lock of
+    // ConcurrentHashMap or from ReadMostlyHashMap readers.
+    struct StatsCounters {
+        std::atomic<size_t> hits{0};
+        std::atomic<size_t> hit_probes{0};
+        std::atomic<size_t> misses{0};
+        std::atomic<size_t> miss_probes{0};
+        std::atomic<size_t> rehash_count{0};
+        std::atomic<int64_t> rehash_nanoseconds{0};
+
+        StatsCounters() = default;
+        StatsCounters(const StatsCounters& other);
+        StatsCounters& operator=(const StatsCounters& other);
+    };
 
-    size_t get_hash(const KeyType v) const;  // NOLINT
+    mutable StatsCounters stats_counters_;
+#endif
+
+    void Build(size_t min_bucket_count);
+
+    // Hooks for stats(); without HASHMAP_ENABLE_STATS they are empty and compile away.
+    using StatsClock = std::chrono::steady_clock;
+    void record_lookup(bool found, size_t probes) const;                // NOLINT
+    static StatsClock::time_point stats_now();                          // NOLINT
+    void record_rehash(StatsClock::time_point start, bool new_table);  // NOLINT
+
+    template <class K, class... Args>
+    std::pair<iterator, bool> try_emplace_key(K&& key, Args&&... args);  // NOLINT
+    template <class K, class... Args>
+    std::pair<iterator, bool> try_emplace_hashed(size_t hash, K&& key, Args&&... args);  // NOLINT
+    // Gives the node at data_.back() a slot, growing the table first if needed.
+    iterator insert_back(size_t hash);  // NOLINT
+
+    // Run by every insert and erase: migrates a share of old_hash_map_ and, in incremental
+    // mode, prepares a share of next_hash_map_, both sized to be done when hash_map_ is full.
+    void rehash_step();                             // NOLINT
+    void begin_migration(size_t min_bucket_count);  // NOLINT
+    void migrate_step(size_t count);                // NOLINT
+    void finish_migration();                        // NOLINT
+    // Appends up to count empty slots to next_hash_map_, sizing it for min_bucket_count
+    // buckets first if its preparation has not started.
+    void prepare_step(size_t min_bucket_count, size_t count);  // NOLINT
+
+    void reset_buckets(Table& table, size_t min_bucket_count);  // NOLINT
+    void set_ctrl(Table& table, size_t pos, int8_t tag);        // NOLINT
+    void place_slot(Table& table, Slot now, size_t pos);        // NOLINT
+    void erase_slot(Table& table, size_t pos);                  // NOLINT
+
+    template <class K>
+    size_t find_position(const Table& table, const K& v, uint32_t fingerprint, size_t pos,  // NOLINT
+                         uint32_t dist) const;
+    template <class K>
+    size_t find_old_position(const K& v, size_t hash, uint32_t fingerprint) const;  // NOLINT
+    template <class K>
+    const Slot* find_slot(const K& v, size_t hash) const;  // NOLINT
+    template <class K>
+    size_t erase_key(const K& v);  // NOLINT
+    // Calls chunk(index, begin, end) for the chunk_count contiguous chunks of [0, count), each on
+    // its own thread except the first; see parallel_for_each.
+    static size_t parallel_chunk_count(size_t count, size_t thread_count);  // NOLINT
+    template <class Chunk>
+    static void run_parallel(size_t count, size_t chunk_count, Chunk chunk);  // NOLINT
+    // Calls resolve(*it, hash) for every it in [first, last), prefetching ahead as described at
+    // find_batch; get_key extracts the key from *it.
+    template <class ForwardIt, class GetKey, class Resolve>
+    void for_each_prefetched(ForwardIt first, ForwardIt last, GetKey get_key, Resolve resolve) const;  // NOLINT
+
+    template <class K>
+    size_t get_hash(const K& v) const;             // NOLINT
+    static uint32_t get_fingerprint(size_t hash);  // NOLINT
+    static int8_t get_tag(uint32_t fingerprint);   // NOLINT
 };
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::Node::Node() {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::Node::Node() {
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::Node::Node(const Node& other) : x_(other.x_), psl(other.psl) {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class... Args>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::Node::Node(
+    Args&&... args)
+    : x_(std::forward<Args>(args)...) {
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::Node::Node(const std::pair<const KeyType, ValueType> x) : x_(x), psl(0) {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+std::pair<const KeyType, ValueType>&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::Node::value() {
+    return *std::launder(reinterpret_cast<std::pair<const KeyType, ValueType>*>(&x_));
 }
 
-template <class KeyType, class ValueType, class Hash>
-typename HashMap<KeyType, ValueType, Hash>::Node& HashMap<KeyType, ValueType, Hash>::Node::operator=(
-    const HashMap::Node& other) {
-    return (*this);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+const std::pair<const KeyType, ValueType>&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::Node::value() const {
+    return *std::launder(reinterpret_cast<const std::pair<const KeyType, ValueType>*>(&x_));
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class NodeT, class NodeVectorT>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::ContiguousCursor<NodeT, NodeVectorT>::ContiguousCursor(NodeVectorT* container, size_t index)
+    : node(container->data() + index) {
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::iterator::iterator(const HashMap::iterator& it) : begin_(it.begin_), it_(it.it_) {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class NodeT, class NodeVectorT>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+             StoragePolicy>::ContiguousCursor<NodeT, NodeVectorT>::next() {
+    ++node;
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::iterator::iterator(typename std::vector<std::pair<size_t, Node*>*>::iterator begin,
-                                                      size_t id)
-    : begin_(begin), it_(id) {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class NodeT, class NodeVectorT>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::ChunkedCursor<NodeT, NodeVectorT>::ChunkedCursor(NodeVectorT* container, size_t index)
+    : nodes(container), id(index), node(container->address(index)) {
 }
 
-template <class KeyType, class ValueType, class Hash>
-std::pair<const KeyType, ValueType>& HashMap<KeyType, ValueType, Hash>::iterator::operator*() const {
-    return (*(begin_ + it_))->second->x_;
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class NodeT, class NodeVectorT>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+             StoragePolicy>::ChunkedCursor<NodeT, NodeVectorT>::next() {
+    ++id;
+    node = NodeVectorT::starts_chunk(id) ? nodes->address(id) : node + 1;
 }
 
-template <class KeyType, class ValueType, class Hash>
-std::pair<const KeyType, ValueType>* HashMap<KeyType, ValueType, Hash>::iterator::operator->() const {
-    std::pair<const KeyType, ValueType>* tmp = &((*(begin_ + it_))->second->x_);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator::iterator(
+    const HashMap::iterator& it)
+    : cursor_(it.cursor_) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator::operator=(
+    const HashMap::iterator& it) {
+    cursor_ = it.cursor_;
+    return (*this);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator::iterator(
+    NodeVector* nodes, size_t id)
+    : cursor_(nodes, id) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+std::pair<const KeyType, ValueType>&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator::operator*(
+    ) const {
+    return cursor_.node->value();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+std::pair<const KeyType, ValueType>*
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator::operator->(
+    ) const {
+    std::pair<const KeyType, ValueType>* tmp = &(cursor_.node->value());
     return tmp;
 }
 
-template <class KeyType, class ValueType, class Hash>
-typename HashMap<KeyType, ValueType, Hash>::iterator HashMap<KeyType, ValueType, Hash>::iterator::operator++(int) {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator::operator++(
+    int) {
     auto it = *this;
-    ++it_;
+    ++(*this);
     return it;
 }
 
-template <class KeyType, class ValueType, class Hash>
-bool HashMap<KeyType, ValueType, Hash>::iterator::operator==(const HashMap::iterator& other) const {
-    return it_ == other.it_ && begin_ == other.begin_;
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+bool
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator::operator==(
+    const HashMap::iterator& other) const {
+    return cursor_.node == other.cursor_.node;
 }
 
-template <class KeyType, class ValueType, class Hash>
-bool HashMap<KeyType, ValueType, Hash>::iterator::operator!=(const HashMap::iterator& other) const {
-    return it_ != other.it_ || begin_ != other.begin_;
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+bool
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator::operator!=(
+    const HashMap::iterator& other) const {
+    return cursor_.node != other.cursor_.node;
 }
 
-template <class KeyType, class ValueType, class Hash>
-typename HashMap<KeyType, ValueType, Hash>::iterator& HashMap<KeyType, ValueType, Hash>::iterator::operator++() {
-    ++it_;
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator::operator++(
+    ) {
+    cursor_.next();
     return (*this);
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::iterator::iterator() {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator::iterator() {
 }
 
-template <class KeyType, class ValueType, class Hash>
-const std::pair<const KeyType, ValueType>& HashMap<KeyType, ValueType, Hash>::const_iterator::operator*() const {
-    return (*(begin_ + it_))->second->x_;
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+const std::pair<const KeyType, ValueType>&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::const_iterator::operator*() const {
+    return cursor_.node->value();
 }
 
-template <class KeyType, class ValueType, class Hash>
-const std::pair<const KeyType, ValueType>* HashMap<KeyType, ValueType, Hash>::const_iterator::operator->() const {
-    const std::pair<const KeyType, ValueType>* tmp = &((*(begin_ + it_))->second->x_);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+const std::pair<const KeyType, ValueType>*
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::const_iterator::operator->() const {
+    const std::pair<const KeyType, ValueType>* tmp = &(cursor_.node->value());
     return tmp;
 }
 
-template <class KeyType, class ValueType, class Hash>
-typename HashMap<KeyType, ValueType, Hash>::const_iterator&
-HashMap<KeyType, ValueType, Hash>::const_iterator::operator++() {
-    ++it_;
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+                 StoragePolicy>::const_iterator&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::const_iterator::operator++() {
+    cursor_.next();
     return (*this);
 }
 
-template <class KeyType, class ValueType, class Hash>
-typename HashMap<KeyType, ValueType, Hash>::const_iterator
-HashMap<KeyType, ValueType, Hash>::const_iterator::operator++(int) {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::const_iterator
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::const_iterator::operator++(int) {
     auto it = *this;
-    ++it_;
+    ++(*this);
     return it;
 }
 
-template <class KeyType, class ValueType, class Hash>
-bool HashMap<KeyType, ValueType, Hash>::const_iterator::operator==(const HashMap::const_iterator& other) const {
-    return it_ == other.it_ && begin_ == other.begin_;
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+bool HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+             StoragePolicy>::const_iterator::operator==(const HashMap::const_iterator& other) const {
+    return cursor_.node == other.cursor_.node;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+bool HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+             StoragePolicy>::const_iterator::operator!=(const HashMap::const_iterator& other) const {
+    return cursor_.node != other.cursor_.node;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::const_iterator::const_iterator(const HashMap::const_iterator& it)
+    : cursor_(it.cursor_) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+                 StoragePolicy>::const_iterator&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::const_iterator::operator=(const HashMap::const_iterator& it) {
+    cursor_ = it.cursor_;
+    return (*this);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::const_iterator::const_iterator(const NodeVector* nodes, size_t id)
+    : cursor_(nodes, id) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::const_iterator::const_iterator() {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::Table::Table(
+    const Allocator& allocator)
+    : slots(allocator), ctrl(allocator) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::Table::Table(
+    const Table& other, const Allocator& allocator)
+    : slots(other.slots, allocator), ctrl(other.ctrl, allocator), growth(other.growth) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::HashMap()
+    : HashMap(Hash(), Equal(), Allocator()) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::HashMap(
+    std::initializer_list<std::pair<KeyType, ValueType>> list)
+    : HashMap(list, Hash(), Equal(), Allocator()) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::HashMap(
+    const Allocator& allocator)
+    : HashMap(Hash(), Equal(), allocator) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::HashMap(
+    Hash hasher, Equal equal, const Allocator& allocator)
+    : hasher_(hasher),
+      equal_(equal),
+      data_(allocator),
+      hash_map_(allocator),
+      old_hash_map_(allocator),
+      next_hash_map_(allocator) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::HashMap(
+    std::initializer_list<std::pair<KeyType, ValueType>> list, Hash hasher, Equal equal, const Allocator& allocator)
+    : HashMap(hasher, equal, allocator) {
+    insert(list.begin(), list.end());
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+size_t HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::size() const {
+    return data_.size();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+bool HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::empty() const {
+    return data_.empty();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+Hash
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::hash_function() const {
+    return hasher_;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+Equal HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::key_eq() const {
+    return equal_;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+Allocator
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::get_allocator() const {
+    return Allocator(data_.get_allocator());
 }
 
-template <class KeyType, class ValueType, class Hash>
-bool HashMap<KeyType, ValueType, Hash>::const_iterator::operator!=(const HashMap::const_iterator& other) const {
-    return it_ != other.it_ || begin_ != other.begin_;
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+std::pair<typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+                           StoragePolicy>::iterator, bool>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::insert(
+    const std::pair<KeyType, ValueType>& x) {
+    return try_emplace_key(x.first, x.second);
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::const_iterator::const_iterator(const HashMap::const_iterator& it)
-    : begin_(it.begin_), it_(it.it_) {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+std::pair<typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+                           StoragePolicy>::iterator, bool>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::insert(
+    std::pair<KeyType, ValueType>&& x) {
+    return try_emplace_key(std::move(x.first), std::move(x.second));
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::const_iterator::const_iterator(
-    typename std::vector<std::pair<size_t, Node*>*>::const_iterator begin, size_t id)
-    : begin_(begin), it_(id) {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class ForwardIt>
+size_t HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::insert_batch(
+    ForwardIt first, ForwardIt last) {
+    size_t inserted = 0;
+    for_each_prefetched(
+        first, last, [](const auto& x) -> const auto& { return x.first; },
+        [this, &inserted](const auto& x, size_t hash) {
+            inserted += try_emplace_hashed(hash, x.first, x.second).second;
+        });
+    return inserted;
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::const_iterator::const_iterator() {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class InputIt>
+void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::insert(
+    InputIt first, InputIt last) {
+    using Category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>) {
+        reserve(size() + static_cast<size_t>(std::distance(first, last)));
+        insert_batch(first, last);
+    } else {
+        for (; first != last; ++first) {
+            insert(*first);
+        }
+    }
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::HashMap() {
-    hash_map_.resize(initial_bucket_count_, std::make_pair(initial_bucket_count_, nullptr));
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::reserve(size_t count) {
+    size_t required = static_cast<size_t>(count / max_load_factor_) + 1;
+    if (required > hash_map_.slots.size()) {
+        Build(required);
+    }
+    data_.reserve(count);
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::HashMap(std::initializer_list<std::pair<KeyType, ValueType>> list) {
-    hash_map_.resize(initial_bucket_count_, std::make_pair(initial_bucket_count_, nullptr));
-    for (auto x : list) {
-        insert(x);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class... Args>
+std::pair<typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+                           StoragePolicy>::iterator, bool>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::emplace(
+    Args&&... args) {
+    // The key is only known once the pair exists, so it is built in place at the end of data_
+    // and looked up from there.
+    data_.emplace_back(std::forward<Args>(args)...);
+    const KeyType& key = data_.back().x_.first;
+    size_t hash = get_hash(key);
+    const Slot* slot = find_slot(key, hash);
+    if (slot != nullptr) {
+        data_.pop_back();
+        return {iterator(&data_, slot->id), false};
     }
+    return {insert_back(hash), true};
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::HashMap(Hash hasher) : hasher_(hasher) {
-    hash_map_.resize(initial_bucket_count_, std::make_pair(initial_bucket_count_, nullptr));
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class... Args>
+std::pair<typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+                           StoragePolicy>::iterator, bool>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::try_emplace(
+    const KeyType& key, Args&&... args) {
+    return try_emplace_key(key, std::forward<Args>(args)...);
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::HashMap(std::initializer_list<std::pair<KeyType, ValueType>> list, Hash hasher)
-    : hasher_(hasher) {
-    hash_map_.resize(initial_bucket_count_, std::make_pair(initial_bucket_count_, nullptr));
-    for (auto x : list) {
-        insert(x);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class... Args>
+std::pair<typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+                           StoragePolicy>::iterator, bool>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::try_emplace(
+    KeyType&& key, Args&&... args) {
+    return try_emplace_key(std::move(key), std::forward<Args>(args)...);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class M>
+std::pair<typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+                           StoragePolicy>::iterator, bool>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::insert_or_assign(
+    const KeyType& key, M&& obj) {
+    auto result = try_emplace_key(key, std::forward<M>(obj));
+    if (!result.second) {
+        result.first->second = std::forward<M>(obj);
     }
+    return result;
 }
 
-template <class KeyType, class ValueType, class Hash>
-size_t HashMap<KeyType, ValueType, Hash>::size() const {
-    return all_elements_.size();
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class M>
+std::pair<typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+                           StoragePolicy>::iterator, bool>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::insert_or_assign(
+    KeyType&& key, M&& obj) {
+    auto result = try_emplace_key(std::move(key), std::forward<M>(obj));
+    if (!result.second) {
+        result.first->second = std::forward<M>(obj);
+    }
+    return result;
 }
 
-template <class KeyType, class ValueType, class Hash>
-bool HashMap<KeyType, ValueType, Hash>::empty() const {
-    return (all_elements_.size() == 0);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K, class... Args>
+std::pair<typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+                           StoragePolicy>::iterator, bool>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::try_emplace_key(
+    K&& key, Args&&... args) {
+    size_t hash = get_hash(key);
+    return try_emplace_hashed(hash, std::forward<K>(key), std::forward<Args>(args)...);
 }
 
-template <class KeyType, class ValueType, class Hash>
-Hash HashMap<KeyType, ValueType, Hash>::hash_function() const {
-    return hasher_;
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K, class... Args>
+std::pair<typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+                           StoragePolicy>::iterator, bool>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::try_emplace_hashed(
+    size_t hash, K&& key, Args&&... args) {
+    const Slot* slot = find_slot(key, hash);
+    if (slot != nullptr) {
+        return {iterator(&data_, slot->id), false};
+    }
+    data_.emplace_back(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                       std::forward_as_tuple(std::forward<Args>(args)...));
+    return {insert_back(hash), true};
 }
 
-template <class KeyType, class ValueType, class Hash>
-void HashMap<KeyType, ValueType, Hash>::insert(const std::pair<KeyType, ValueType> x) {
-    auto it = find(x.first);
-    if (it != end()) {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::insert_back(
+    size_t hash) {
+    rehash_step();
+    if (data_.size() > kEmptySlot) {
+        data_.pop_back();
+        throw std::length_error("HashMap holds at most 2^32 - 1 elements");
+    }
+    uint32_t id = static_cast<uint32_t>(data_.size() - 1);
+    if (data_.size() > max_load_factor_ * hash_map_.slots.size()) {
+        if (incremental_rehash_ && !hash_map_.slots.empty()) {
+            begin_migration(2 * hash_map_.slots.size());
+        } else {
+            // Build gives every node of data_ a slot, the new one included.
+            Build(2 * hash_map_.slots.size());
+            return iterator(&data_, id);
+        }
+    }
+
+    place_slot(hash_map_, Slot{id, 0, get_fingerprint(hash)}, hash_map_.growth.bucket_for_hash(hash));
+    return iterator(&data_, id);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+size_t HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::erase(
+    const KeyType& v) {
+    return erase_key(v);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K>
+auto HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::erase(
+    const K& v) -> EnableIfTransparent<K, size_t> {
+    return erase_key(v);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K>
+size_t
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::erase_key(const K& v) {
+    rehash_step();
+    size_t hash = get_hash(v);
+    uint32_t fingerprint = get_fingerprint(hash);
+    Table* table = &hash_map_;
+    size_t pos = find_position(hash_map_, v, fingerprint, hash_map_.growth.bucket_for_hash(hash), 0);
+    if (pos == hash_map_.slots.size() && !old_hash_map_.slots.empty()) {
+        table = &old_hash_map_;
+        pos = find_old_position(v, hash, fingerprint);
+    }
+    if (pos == table->slots.size()) {
+        return 0;
+    }
+    // data_[id] always holds element id: the last node fills the hole left by the erased one,
+    // and its slot, found by looking its key up again, is pointed at the new index.
+    uint32_t id = table->slots[pos].id;
+    if (id + 1 != data_.size()) {
+        const KeyType& last = data_.back().x_.first;
+        const_cast<Slot*>(find_slot(last, get_hash(last)))->id = id;
+        data_[id] = std::move(data_.back());
+    }
+    data_.pop_back();
+    erase_slot(*table, pos);
+    return 1;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::Build(
+    size_t min_bucket_count) {
+    StatsClock::time_point start = stats_now();
+    size_t required = static_cast<size_t>((data_.size() + 1) / max_load_factor_) + 1;
+    // Nodes stay where they are in data_; only their slots are recomputed.
+    old_hash_map_ = Table(get_allocator());
+    migrated_ = 0;
+    next_hash_map_ = Table(get_allocator());
+    hash_map_ = Table(get_allocator());
+    reset_buckets(hash_map_, std::max(min_bucket_count, required));
+    for (uint32_t id = 0; id < data_.size(); ++id) {
+        size_t hash = get_hash(data_[id].x_.first);
+        place_slot(hash_map_, Slot{id, 0, get_fingerprint(hash)}, hash_map_.growth.bucket_for_hash(hash));
+    }
+    record_rehash(start, true);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::rehash_step() {
+    // Inserts left until the one that makes hash_map_ grow, this one included. Both the
+    // migration and the preparation are spread over them in equal shares.
+    size_t limit = static_cast<size_t>(max_load_factor_ * hash_map_.slots.size());
+    size_t left = limit >= data_.size() ? limit - data_.size() + 1 : 1;
+    if (!old_hash_map_.slots.empty()) {
+        size_t remaining = old_hash_map_.slots.size() - migrated_;
+        migrate_step(std::max(kMigrationStep, (remaining + left - 1) / left));
+    }
+    if (!incremental_rehash_ || hash_map_.slots.empty()) {
+        return;
+    }
+    size_t bucket_count = 2 * hash_map_.slots.size();
+    if (next_hash_map_.slots.empty() && left * kPrepareStep > bucket_count) {
         return;
     }
-    if (all_elements_.size() + 1 > max_load_factor_ * hash_map_.size() || data_.size() == data_.capacity()) {
-        Build();
+    StatsClock::time_point start = stats_now();
+    if (!next_hash_map_.slots.empty()) {
+        bucket_count = next_hash_map_.growth.bucket_count();
     }
+    size_t remaining = bucket_count - next_hash_map_.slots.size();
+    prepare_step(2 * hash_map_.slots.size(), std::max(kPrepareStep, (remaining + left - 1) / left));
+    record_rehash(start, false);
+}
 
-    size_t pos = get_hash(x.first);
-    data_.emplace_back(x);
-    all_elements_.push_back(nullptr);
-    std::pair<size_t, Node*> now = std::make_pair(all_elements_.size() - 1, &data_.back());
-    while (hash_map_[pos].second != nullptr) {
-        if (now.second->psl > hash_map_[pos].second->psl) {
-            swap(now, hash_map_[pos]);
-            swap(all_elements_[now.first], all_elements_[hash_map_[pos].first]);
-        }
-        ++now.second->psl;
-        ++pos;
-        if (pos == hash_map_.size()) {
-            pos = 0;
-        }
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::begin_migration(
+    size_t min_bucket_count) {
+    finish_migration();
+    StatsClock::time_point start = stats_now();
+    // Normally the preparation is complete by now; only what is left of it is done here.
+    prepare_step(min_bucket_count, static_cast<size_t>(-1));
+    old_hash_map_ = std::move(hash_map_);
+    hash_map_ = std::move(next_hash_map_);
+    next_hash_map_ = Table(get_allocator());
+    // Starting at an empty slot means no cluster of the old table is split by the cursor
+    // except the one being migrated, whose keys are then looked up from the cursor on.
+    migrate_start_ = 0;
+    while (old_hash_map_.slots[migrate_start_].id != kEmptySlot) {
+        ++migrate_start_;
     }
-    hash_map_[pos] = now;
-    all_elements_[hash_map_[pos].first] = &hash_map_[pos];
+    migrated_ = 0;
+    record_rehash(start, true);
 }
 
-template <class KeyType, class ValueType, class Hash>
-void HashMap<KeyType, ValueType, Hash>::erase(const KeyType v) {
-    size_t pos = get_hash(v);
-    while (hash_map_[pos].second != nullptr && !((hash_map_[pos].second->x_).first == v)) {  // NOLINT
-        ++pos;
-        if (pos == hash_map_.size()) {
-            pos = 0;
-        }
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::migrate_step(
+    size_t count) {
+    if (old_hash_map_.slots.empty()) {
+        return;
     }
-    if (hash_map_[pos].second != nullptr) {
-        all_elements_.back()->first = hash_map_[pos].first;
-        swap(all_elements_[hash_map_[pos].first], all_elements_.back());
-        all_elements_.pop_back();
-        hash_map_[pos].second = nullptr;
-        while (true) {
-            size_t nxt = pos + 1;
-            if (nxt == hash_map_.size()) {
-                nxt = 0;
-            }
-            if (hash_map_[nxt].second != nullptr && hash_map_[nxt].second->psl != 0) {
-                all_elements_[hash_map_[nxt].first] = &hash_map_[pos];
-                swap(hash_map_[nxt], hash_map_[pos]);
-                --hash_map_[pos].second->psl;
-                pos = nxt;
-            } else {
-                break;
+    StatsClock::time_point start = stats_now();
+    for (size_t i = 0; i < count && migrated_ < old_hash_map_.slots.size(); ++i, ++migrated_) {
+        size_t pos = old_hash_map_.growth.next_bucket(migrate_start_, migrated_);
+        Slot& slot = old_hash_map_.slots[pos];
+        if (slot.id != kEmptySlot) {
+            Slot moved = {slot.id, 0, slot.fingerprint};
+            slot.id = kEmptySlot;
+            if constexpr (ProbingPolicy::kUseControlBytes) {
+                set_ctrl(old_hash_map_, pos, ProbingPolicy::kEmpty);
             }
+            place_slot(hash_map_, moved, hash_map_.growth.bucket_for_hash(get_hash(data_[moved.id].x_.first)));
         }
     }
+    if (migrated_ == old_hash_map_.slots.size()) {
+        old_hash_map_ = Table(get_allocator());
+        migrated_ = 0;
+    }
+    record_rehash(start, false);
 }
 
-template <class KeyType, class ValueType, class Hash>
-void HashMap<KeyType, ValueType, Hash>::Build() {
-    size_t new_size_id = 0;
-    while (all_elements_.size() + 1 > bucket_counts_[new_size_id] * max_load_factor_) {
-        ++new_size_id;
-    }
-    size_t new_size = bucket_counts_[new_size_id];
-    std::vector<std::pair<const KeyType, ValueType>> tmp;
-    for (auto c : all_elements_) {
-        tmp.push_back(c->second->x_);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::finish_migration() {
+    migrate_step(old_hash_map_.slots.size());
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::prepare_step(
+    size_t min_bucket_count, size_t count) {
+    Table& table = next_hash_map_;
+    if (table.slots.empty()) {
+        // Reserving only allocates; the memory is written, and for large arrays first touched,
+        // by the steps.
+        table.growth = GrowthPolicy(min_bucket_count);
+        table.slots.reserve(table.growth.bucket_count());
+        if constexpr (ProbingPolicy::kUseControlBytes) {
+            table.ctrl.reserve(table.growth.bucket_count() + ProbingPolicy::kGroupWidth - 1);
+        }
     }
-    all_elements_.clear();
-    data_.clear();
-    data_.reserve(new_size);
-    hash_map_.clear();
-    hash_map_.resize(new_size, std::make_pair(0, nullptr));
-    for (auto& x : tmp) {
-        insert(x);
+    size_t bucket_count = table.growth.bucket_count();
+    count = std::min(count, bucket_count - table.slots.size());
+    table.slots.insert(table.slots.end(), count, Slot{kEmptySlot, 0, 0});
+    if constexpr (ProbingPolicy::kUseControlBytes) {
+        // The tags mirrored past the end come with the last slot.
+        size_t size = table.slots.size() == bucket_count ? bucket_count + ProbingPolicy::kGroupWidth - 1
+                                                         : table.slots.size();
+        table.ctrl.resize(size, ProbingPolicy::kEmpty);
     }
 }
 
-template <class KeyType, class ValueType, class Hash>
-typename HashMap<KeyType, ValueType, Hash>::const_iterator HashMap<KeyType, ValueType, Hash>::begin() const {
-    return const_iterator(all_elements_.begin(), 0);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::const_iterator
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::begin() const {
+    return const_iterator(&data_, 0);
 }
 
-template <class KeyType, class ValueType, class Hash>
-typename HashMap<KeyType, ValueType, Hash>::const_iterator HashMap<KeyType, ValueType, Hash>::end() const {
-    return const_iterator(all_elements_.begin(), all_elements_.size());
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::const_iterator
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::end() const {
+    return const_iterator(&data_, data_.size());
 }
 
-template <class KeyType, class ValueType, class Hash>
-typename HashMap<KeyType, ValueType, Hash>::iterator HashMap<KeyType, ValueType, Hash>::begin() {
-    return iterator(all_elements_.begin(), 0);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::begin() {
+    return iterator(&data_, 0);
 }
 
-template <class KeyType, class ValueType, class Hash>
-typename HashMap<KeyType, ValueType, Hash>::iterator HashMap<KeyType, ValueType, Hash>::end() {
-    return iterator(all_elements_.begin(), all_elements_.size());
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::end() {
+    return iterator(&data_, data_.size());
 }
 
-template <class KeyType, class ValueType, class Hash>
-typename HashMap<KeyType, ValueType, Hash>::iterator HashMap<KeyType, ValueType, Hash>::find(const KeyType v) {
-    size_t pos = get_hash(v);
-    while (hash_map_[pos].second != nullptr && !((hash_map_[pos].second->x_).first == v)) {  // NOLINT
-        ++pos;
-        if (pos == hash_map_.size()) {
-            pos = 0;
-        }
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::iterator
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::find(
+    const KeyType& v) {
+    const Slot* slot = find_slot(v, get_hash(v));
+    if (slot == nullptr) {
+        return end();
+    } else {
+        return iterator(&data_, slot->id);
     }
-    if (hash_map_[pos].second == nullptr) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K>
+auto HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::find(
+    const K& v) -> EnableIfTransparent<K, iterator> {
+    const Slot* slot = find_slot(v, get_hash(v));
+    if (slot == nullptr) {
         return end();
     } else {
-        return iterator(all_elements_.begin(), hash_map_[pos].first);
+        return iterator(&data_, slot->id);
     }
 }
 
-template <class KeyType, class ValueType, class Hash>
-typename HashMap<KeyType, ValueType, Hash>::const_iterator HashMap<KeyType, ValueType, Hash>::find(
-    const KeyType v) const {
-    size_t pos = get_hash(v);
-    while (hash_map_[pos].second != nullptr && !((hash_map_[pos].second->x_).first == v)) {  // NOLINT
-        ++pos;
-        if (pos == hash_map_.size()) {
-            pos = 0;
-        }
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::const_iterator
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::find(
+    const KeyType& v) const {
+    const Slot* slot = find_slot(v, get_hash(v));
+    if (slot == nullptr) {
+        return end();
+    } else {
+        return const_iterator(&data_, slot->id);
     }
-    if (hash_map_[pos].second == nullptr) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K>
+auto HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::find(
+    const K& v) const -> EnableIfTransparent<K, const_iterator> {
+    const Slot* slot = find_slot(v, get_hash(v));
+    if (slot == nullptr) {
         return end();
     } else {
-        return const_iterator(all_elements_.begin(), hash_map_[pos].first);
+        return const_iterator(&data_, slot->id);
     }
 }
 
-template <class KeyType, class ValueType, class Hash>
-template <class Iterator>
-HashMap<KeyType, ValueType, Hash>::HashMap(Iterator begin, Iterator end) {
-    hash_map_.resize(initial_bucket_count_, std::make_pair(0, nullptr));
-    for (auto it = begin; it != end; ++it) {
-        insert(*it);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class ForwardIt, class OutputIt>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::find_batch(
+    ForwardIt first, ForwardIt last, OutputIt out) {
+    for_each_prefetched(
+        first, last, [](const auto& x) -> const auto& { return x; },
+        [this, &out](const auto& x, size_t hash) {
+            const Slot* slot = find_slot(x, hash);
+            *out = slot == nullptr ? end() : iterator(&data_, slot->id);
+            ++out;
+        });
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class ForwardIt, class OutputIt>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::find_batch(
+    ForwardIt first, ForwardIt last, OutputIt out) const {
+    for_each_prefetched(
+        first, last, [](const auto& x) -> const auto& { return x; },
+        [this, &out](const auto& x, size_t hash) {
+            const Slot* slot = find_slot(x, hash);
+            *out = slot == nullptr ? end() : const_iterator(&data_, slot->id);
+            ++out;
+        });
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class ForwardIt, class OutputIt>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::contains_batch(
+    ForwardIt first, ForwardIt last, OutputIt out) const {
+    for_each_prefetched(
+        first, last, [](const auto& x) -> const auto& { return x; },
+        [this, &out](const auto& x, size_t hash) {
+            *out = find_slot(x, hash) != nullptr;
+            ++out;
+        });
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class ForwardIt, class GetKey, class Resolve>
+void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::for_each_prefetched(
+    ForwardIt first, ForwardIt last, GetKey get_key, Resolve resolve) const {
+    // hashes is a ring buffer holding the keys from the one being resolved up to the furthest
+    // one prefetched. Halfway along the window the home slot has usually arrived, so the node it
+    // refers to, the likely match, is requested as well.
+    // An unallocated table has nothing to prefetch; an insert allocates it.
+    for (; first != last && hash_map_.slots.empty(); ++first) {
+        resolve(*first, get_hash(get_key(*first)));
     }
+    size_t hashes[kPrefetchDistance];
+    ForwardIt ahead = first;
+    size_t hashed = 0;
+    for (size_t i = 0; first != last; ++i, ++first) {
+        for (; ahead != last && hashed < i + kPrefetchDistance; ++ahead, ++hashed) {
+            size_t hash = get_hash(get_key(*ahead));
+            hashes[hashed % kPrefetchDistance] = hash;
+            size_t pos = hash_map_.growth.bucket_for_hash(hash);
+            Prefetch(&hash_map_.slots[pos]);
+            if constexpr (ProbingPolicy::kUseControlBytes) {
+                Prefetch(hash_map_.ctrl.data() + pos);
+            }
+        }
+        size_t middle = i + kPrefetchDistance / 2;
+        if (middle < hashed) {
+            size_t pos = hash_map_.growth.bucket_for_hash(hashes[middle % kPrefetchDistance]);
+            if (hash_map_.slots[pos].id != kEmptySlot) {
+                Prefetch(&data_[hash_map_.slots[pos].id]);
+            }
+        }
+        resolve(*first, hashes[i % kPrefetchDistance]);
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+bool
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::contains(
+    const KeyType& v) const {
+    return find_slot(v, get_hash(v)) != nullptr;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K>
+auto HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::contains(
+    const K& v) const -> EnableIfTransparent<K, bool> {
+    return find_slot(v, get_hash(v)) != nullptr;
 }
 
-template <class KeyType, class ValueType, class Hash>
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+size_t HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::count(
+    const KeyType& v) const {
+    return contains(v) ? 1 : 0;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K>
+auto HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::count(
+    const K& v) const -> EnableIfTransparent<K, size_t> {
+    return contains(v) ? 1 : 0;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
 template <class Iterator>
-HashMap<KeyType, ValueType, Hash>::HashMap(Iterator begin, Iterator end, Hash hasher) : hasher_(hasher) {
-    hash_map_.resize(initial_bucket_count_, std::make_pair(0, nullptr));
-    for (auto it = begin; it != end; ++it) {
-        insert(*it);
-    }
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::HashMap(
+    Iterator begin, Iterator end)
+    : HashMap(begin, end, Hash(), Equal(), Allocator()) {
 }
 
-template <class KeyType, class ValueType, class Hash>
-ValueType& HashMap<KeyType, ValueType, Hash>::operator[](const KeyType v) {
-    insert(std::make_pair(v, ValueType()));
-    iterator it = find(v);
-    return it->second;
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class Iterator>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::HashMap(
+    Iterator begin, Iterator end, Hash hasher, Equal equal, const Allocator& allocator)
+    : HashMap(hasher, equal, allocator) {
+    insert(begin, end);
 }
 
-template <class KeyType, class ValueType, class Hash>
-const ValueType& HashMap<KeyType, ValueType, Hash>::at(const KeyType v) const {
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+ValueType&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::operator[](
+    const KeyType& v) {
+    return try_emplace_key(v).first->second;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+ValueType& HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::operator[](
+    KeyType&& v) {
+    return try_emplace_key(std::move(v)).first->second;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+const ValueType&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::at(
+    const KeyType& v) const {
     const_iterator it = find(v);
     if (it == end()) {
         throw std::out_of_range("no such key");
@@ -498,52 +1981,751 @@ const ValueType& HashMap<KeyType, ValueType, Hash>::at(const KeyType v) const {
     return it->second;
 }
 
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>::HashMap(const HashMap& other) {
-    std::vector<std::pair<const KeyType, ValueType>> tmp;
-    for (auto c : other.all_elements_) {
-        tmp.push_back((*c).second->x_);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::HashMap(
+    const HashMap& other)
+    : HashMap(other, AllocatorTraits::select_on_container_copy_construction(other.get_allocator())) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::HashMap(
+    const HashMap& other, const Allocator& allocator)
+    : max_load_factor_(other.max_load_factor_),
+      incremental_rehash_(other.incremental_rehash_),
+      hasher_(other.hasher_),
+      equal_(other.equal_),
+      data_(other.data_, allocator),
+      hash_map_(other.hash_map_, allocator),
+      old_hash_map_(other.old_hash_map_, allocator),
+      migrate_start_(other.migrate_start_),
+      migrated_(other.migrated_),
+      next_hash_map_(allocator) {
+    // Slots refer to nodes by index, so the tables are copied as is instead of being rehashed.
+    // A table in preparation is not copied; the copy starts its own when it nears the limit.
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::HashMap(HashMap&& other) noexcept(kNothrowMoveConstructible)
+    : max_load_factor_(other.max_load_factor_),
+      incremental_rehash_(other.incremental_rehash_),
+      hasher_(std::move(other.hasher_)),
+      equal_(std::move(other.equal_)),
+      data_(std::move(other.data_)),
+      hash_map_(std::move(other.hash_map_)),
+      old_hash_map_(std::move(other.old_hash_map_)),
+      migrate_start_(other.migrate_start_),
+      migrated_(other.migrated_),
+      next_hash_map_(std::move(other.next_hash_map_)) {
+    // Moved-from vectors are empty, so other is left with unallocated tables.
+#if defined(HASHMAP_ENABLE_STATS)
+    stats_counters_ = other.stats_counters_;
+    other.stats_counters_ = StatsCounters();
+#endif
+    other.migrated_ = 0;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::swap(HashMap& other) {
+    std::swap(max_load_factor_, other.max_load_factor_);
+    std::swap(incremental_rehash_, other.incremental_rehash_);
+    std::swap(hasher_, other.hasher_);
+    std::swap(equal_, other.equal_);
+    data_.swap(other.data_);
+    std::swap(hash_map_, other.hash_map_);
+    std::swap(old_hash_map_, other.old_hash_map_);
+    std::swap(migrate_start_, other.migrate_start_);
+    std::swap(migrated_, other.migrated_);
+    std::swap(next_hash_map_, other.next_hash_map_);
+#if defined(HASHMAP_ENABLE_STATS)
+    StatsCounters counters = stats_counters_;
+    stats_counters_ = other.stats_counters_;
+    other.stats_counters_ = counters;
+#endif
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::clear() {
+    if (!old_hash_map_.slots.empty()) {
+        old_hash_map_ = Table(get_allocator());
+        migrated_ = 0;
+        reset_buckets(hash_map_, hash_map_.slots.size());
+    } else if (data_.size() * kSparseRatio >= hash_map_.slots.size()) {
+        std::fill(hash_map_.slots.begin(), hash_map_.slots.end(), Slot{kEmptySlot, 0, 0});
+        if constexpr (ProbingPolicy::kUseControlBytes) {
+            std::fill(hash_map_.ctrl.begin(), hash_map_.ctrl.end(), ProbingPolicy::kEmpty);
+        }
+    } else {
+        // In a sparse table only occupied slots are reset, so the cost stays linear in size()
+        // rather than in the bucket count. A node's slot lies at or after its home slot, and
+        // the slots emptied before it are stepped over.
+        for (uint32_t id = 0; id < data_.size(); ++id) {
+            size_t pos = hash_map_.growth.bucket_for_hash(get_hash(data_[id].x_.first));
+            while (hash_map_.slots[pos].id != id) {
+                pos = hash_map_.growth.next_bucket(pos);
+            }
+            hash_map_.slots[pos].id = kEmptySlot;
+            if constexpr (ProbingPolicy::kUseControlBytes) {
+                set_ctrl(hash_map_, pos, ProbingPolicy::kEmpty);
+            }
+        }
     }
-    size_t sz = other.hash_map_.size();
-    hash_map_.clear();
     data_.clear();
-    all_elements_.clear();
-    hash_map_.resize(sz, std::make_pair(0, nullptr));
-    data_.reserve(sz);
-    for (auto c : tmp) {
-        insert(c);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class Pred>
+size_t
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::erase_if(Pred pred) {
+    finish_migration();
+    // The new index of every node, or kEmptySlot if it is erased. pred runs before anything is
+    // moved, so a throwing pred leaves the map as it was.
+    Vector<uint32_t> new_ids(data_.size(), kEmptySlot, get_allocator());
+    uint32_t kept = 0;
+    for (uint32_t id = 0; id < data_.size(); ++id) {
+        if (!pred(static_cast<const Node&>(data_[id]).value())) {
+            new_ids[id] = kept++;
+        }
+    }
+    size_t erased = data_.size() - kept;
+    if (erased == 0) {
+        return 0;
     }
+    for (uint32_t id = 0; id < data_.size(); ++id) {
+        if (new_ids[id] != kEmptySlot && new_ids[id] != id) {
+            data_[new_ids[id]] = std::move(data_[id]);
+        }
+    }
+    while (data_.size() > kept) {
+        data_.pop_back();
+    }
+
+    // One sweep over the slots, starting at an empty one so that no cluster is split by the
+    // wrap-around. hole is the number of free slots right before pos; a remaining slot moves
+    // back by as many of them as its psl allows, which keeps the Robin Hood order.
+    size_t start = 0;
+    while (hash_map_.slots[start].id != kEmptySlot) {
+        ++start;
+    }
+    size_t hole = 0;
+    for (size_t i = 0; i < hash_map_.slots.size(); ++i) {
+        size_t pos = hash_map_.growth.next_bucket(start, i);
+        Slot slot = hash_map_.slots[pos];
+        if (slot.id == kEmptySlot) {
+            ++hole;
+            continue;
+        }
+        slot.id = new_ids[slot.id];
+        if (slot.id == kEmptySlot) {
+            hash_map_.slots[pos].id = kEmptySlot;
+            if constexpr (ProbingPolicy::kUseControlBytes) {
+                set_ctrl(hash_map_, pos, ProbingPolicy::kEmpty);
+            }
+            ++hole;
+            continue;
+        }
+        size_t shift = std::min<size_t>(hole, slot.psl);
+        if (shift == 0) {
+            hash_map_.slots[pos] = slot;
+        } else {
+            size_t target = hash_map_.growth.next_bucket(start, i - shift);
+            slot.psl -= shift;
+            hash_map_.slots[target] = slot;
+            hash_map_.slots[pos].id = kEmptySlot;
+            if constexpr (ProbingPolicy::kUseControlBytes) {
+                set_ctrl(hash_map_, target, get_tag(slot.fingerprint));
+                set_ctrl(hash_map_, pos, ProbingPolicy::kEmpty);
+            }
+        }
+        hole = shift;
+    }
+    return erased;
 }
 
-template <class KeyType, class ValueType, class Hash>
-void HashMap<KeyType, ValueType, Hash>::clear() {
-    std::vector<std::pair<const KeyType, ValueType>> tmp;
-    for (auto c : all_elements_) {
-        tmp.push_back((*c).second->x_);
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class Fn>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::parallel_for_each(
+    Fn fn, size_t thread_count) {
+    run_parallel(data_.size(), parallel_chunk_count(data_.size(), thread_count),
+                 [this, &fn](size_t, size_t begin, size_t end) {
+                     for (size_t id = begin; id < end; ++id) {
+                         fn(data_[id].value());
+                     }
+                 });
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class Fn>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::parallel_for_each(
+    Fn fn, size_t thread_count) const {
+    run_parallel(data_.size(), parallel_chunk_count(data_.size(), thread_count),
+                 [this, &fn](size_t, size_t begin, size_t end) {
+                     for (size_t id = begin; id < end; ++id) {
+                         fn(data_[id].value());
+                     }
+                 });
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class T, class Reduce, class Transform>
+T HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::parallel_reduce(
+    T init, Reduce reduce, Transform transform, size_t thread_count) const {
+    if (data_.empty()) {
+        return init;
     }
-    for (auto c : tmp) {
-        erase(c.first);
+    // Every chunk is non-empty, so each partial result starts from its first element and init
+    // is folded in exactly once.
+    size_t chunk_count = parallel_chunk_count(data_.size(), thread_count);
+    std::vector<std::optional<T>> partial(chunk_count);
+    run_parallel(data_.size(), chunk_count, [this, &partial, &reduce, &transform](size_t index, size_t begin,
+                                                                                  size_t end) {
+        T result = transform(data_[begin].value());
+        for (size_t id = begin + 1; id < end; ++id) {
+            result = reduce(std::move(result), transform(data_[id].value()));
+        }
+        partial[index] = std::move(result);
+    });
+    for (std::optional<T>& result : partial) {
+        init = reduce(std::move(init), std::move(*result));
     }
+    return init;
 }
 
-template <class KeyType, class ValueType, class Hash>
-size_t HashMap<KeyType, ValueType, Hash>::get_hash(const KeyType v) const {
-    return (hasher_(v) * 30011 + 179) % hash_map_.size();
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+size_t
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::parallel_chunk_count(
+    size_t count, size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    return std::max<size_t>(std::min(thread_count, count / kParallelGrain), 1);
 }
-template <class KeyType, class ValueType, class Hash>
-HashMap<KeyType, ValueType, Hash>& HashMap<KeyType, ValueType, Hash>::operator=(const HashMap& other) {
-    std::vector<std::pair<const KeyType, ValueType>> tmp;
-    for (auto c : other.all_elements_) {
-        tmp.push_back((*c).second->x_);
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class Chunk>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::run_parallel(
+    size_t count, size_t chunk_count, Chunk chunk) {
+    std::vector<std::exception_ptr> errors(chunk_count);
+    auto run = [count, chunk_count, &chunk, &errors](size_t index) {
+        try {
+            chunk(index, count * index / chunk_count, count * (index + 1) / chunk_count);
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(chunk_count - 1);
+    for (size_t index = 1; index < chunk_count; ++index) {
+        try {
+            threads.emplace_back(run, index);
+        } catch (const std::system_error&) {
+            // Out of threads: the caller runs the chunk itself.
+            run(index);
+        }
     }
-    size_t sz = other.hash_map_.size();
-    hash_map_.clear();
-    data_.clear();
-    all_elements_.clear();
-    hash_map_.resize(sz, std::make_pair(0, nullptr));
-    data_.reserve(sz);
-    for (auto c : tmp) {
-        insert(c);
+    run(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::shrink_to_fit() {
+    data_.shrink_to_fit();
+    Build(0);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+size_t
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::bucket_count() const {
+    return hash_map_.slots.size();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+float
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::load_factor() const {
+    if (hash_map_.slots.empty()) {
+        return 0.0f;
+    }
+    return static_cast<float>(data_.size()) / static_cast<float>(hash_map_.slots.size());
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+float HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::max_load_factor(
+    ) const {
+    return static_cast<float>(max_load_factor_);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::max_load_factor(
+    float max_load_factor) {
+    // The table always keeps an empty slot, which ends every probe sequence.
+    if (!(max_load_factor > 0 && max_load_factor < 1)) {
+        throw std::invalid_argument("max_load_factor must lie in (0, 1)");
+    }
+    max_load_factor_ = max_load_factor;
+    if (data_.size() > max_load_factor_ * hash_map_.slots.size()) {
+        Build(0);
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::rehash(
+    size_t bucket_count) {
+    Build(bucket_count);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+size_t HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+               StoragePolicy>::MemoryUsage::total() const {
+    return hash_map + rehash + data;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::MemoryUsage
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::memory_usage() const {
+    auto bytes = [](const Table& table) {
+        return table.slots.capacity() * sizeof(Slot) + table.ctrl.capacity() * sizeof(int8_t);
+    };
+    MemoryUsage usage;
+    usage.hash_map = bytes(hash_map_);
+    usage.rehash = bytes(old_hash_map_) + bytes(next_hash_map_);
+    usage.data = data_.capacity() * sizeof(Node);
+    return usage;
+}
+
+#if defined(HASHMAP_ENABLE_STATS)
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+double
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::Stats::average_hit_probes() const {
+    return hits == 0 ? 0.0 : static_cast<double>(hit_probes) / hits;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+double
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::Stats::average_miss_probes() const {
+    return misses == 0 ? 0.0 : static_cast<double>(miss_probes) / misses;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::Stats
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::stats() const {
+    Stats stats;
+    stats.max_psl = 0;
+    for (const Table* table : {&hash_map_, &old_hash_map_}) {
+        for (const Slot& slot : table->slots) {
+            if (slot.id == kEmptySlot) {
+                continue;
+            }
+            if (slot.psl >= stats.psl_histogram.size()) {
+                stats.psl_histogram.resize(slot.psl + 1, 0);
+            }
+            ++stats.psl_histogram[slot.psl];
+            stats.max_psl = std::max(stats.max_psl, slot.psl);
+        }
+    }
+    stats.load_factor = load_factor();
+    stats.unused_data_bytes = (data_.capacity() - data_.size()) * sizeof(Node);
+    stats.hits = stats_counters_.hits.load(std::memory_order_relaxed);
+    stats.hit_probes = stats_counters_.hit_probes.load(std::memory_order_relaxed);
+    stats.misses = stats_counters_.misses.load(std::memory_order_relaxed);
+    stats.miss_probes = stats_counters_.miss_probes.load(std::memory_order_relaxed);
+    stats.rehash_count = stats_counters_.rehash_count.load(std::memory_order_relaxed);
+    stats.rehash_time = std::chrono::nanoseconds(stats_counters_.rehash_nanoseconds.load(std::memory_order_relaxed));
+    return stats;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::reset_stats() {
+    stats_counters_ = StatsCounters();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::StatsCounters::StatsCounters(const StatsCounters& other) {
+    *this = other;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::StatsCounters&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::StatsCounters::operator=(const StatsCounters& other) {
+    hits.store(other.hits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    hit_probes.store(other.hit_probes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    misses.store(other.misses.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    miss_probes.store(other.miss_probes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    rehash_count.store(other.rehash_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    rehash_nanoseconds.store(other.rehash_nanoseconds.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+}
+#endif
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+inline void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::record_lookup(
+    bool found, size_t probes) const {
+#if defined(HASHMAP_ENABLE_STATS)
+    if (found) {
+        stats_counters_.hits.fetch_add(1, std::memory_order_relaxed);
+        stats_counters_.hit_probes.fetch_add(probes, std::memory_order_relaxed);
+    } else {
+        stats_counters_.misses.fetch_add(1, std::memory_order_relaxed);
+        stats_counters_.miss_probes.fetch_add(probes, std::memory_order_relaxed);
+    }
+#else
+    static_cast<void>(found);
+    static_cast<void>(probes);
+#endif
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+inline typename
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::StatsClock::time_point
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::stats_now() {
+#if defined(HASHMAP_ENABLE_STATS)
+    return StatsClock::now();
+#else
+    return StatsClock::time_point();
+#endif
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+inline void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::record_rehash(
+    StatsClock::time_point start, bool new_table) {
+#if defined(HASHMAP_ENABLE_STATS)
+    // A migration is counted once when it begins; its steps only add their time.
+    if (new_table) {
+        stats_counters_.rehash_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::chrono::nanoseconds elapsed = StatsClock::now() - start;
+    stats_counters_.rehash_nanoseconds.fetch_add(elapsed.count(), std::memory_order_relaxed);
+#else
+    static_cast<void>(start);
+    static_cast<void>(new_table);
+#endif
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::save(
+    const std::string& path) const {
+    MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::save(*this, path);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+bool HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+             StoragePolicy>::incremental_rehash() const {
+    return incremental_rehash_;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::incremental_rehash(
+    bool enabled) {
+    if (!enabled) {
+        finish_migration();
+        next_hash_map_ = Table(get_allocator());
+    }
+    incremental_rehash_ = enabled;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K>
+size_t HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::get_hash(
+    const K& v) const {
+    return hasher_(v);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+uint32_t
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::get_fingerprint(
+    size_t hash) {
+    // Uses a different multiplier than the growth policies, so the fingerprint does not
+    // repeat the bits that already selected the home slot.
+    return static_cast<uint32_t>((static_cast<uint64_t>(hash) * 0xD6E8FEB86659FD93ull) >> 56);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+int8_t HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::get_tag(
+    uint32_t fingerprint) {
+    return static_cast<int8_t>(fingerprint >> 1);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::reset_buckets(
+    Table& table, size_t min_bucket_count) {
+    table.growth = GrowthPolicy(min_bucket_count);
+    table.slots.assign(table.growth.bucket_count(), Slot{kEmptySlot, 0, 0});
+    if constexpr (ProbingPolicy::kUseControlBytes) {
+        table.ctrl.assign(table.slots.size() + ProbingPolicy::kGroupWidth - 1, ProbingPolicy::kEmpty);
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::set_ctrl(
+    Table& table, size_t pos, int8_t tag) {
+    table.ctrl[pos] = tag;
+    for (size_t mirror = pos + table.slots.size(); mirror < table.ctrl.size(); mirror += table.slots.size()) {
+        table.ctrl[mirror] = tag;
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::place_slot(
+    Table& table, Slot now, size_t pos) {
+    while (table.slots[pos].id != kEmptySlot) {
+        if (now.psl > table.slots[pos].psl) {
+            std::swap(now, table.slots[pos]);
+            if constexpr (ProbingPolicy::kUseControlBytes) {
+                set_ctrl(table, pos, get_tag(table.slots[pos].fingerprint));
+            }
+        }
+        // By now residents have been displaced, so there is no consistent state to throw from.
+        assert(now.psl < kMaxPsl && "probe sequence length overflows the 24-bit slot field");
+        ++now.psl;
+        pos = table.growth.next_bucket(pos);
+    }
+    table.slots[pos] = now;
+    if constexpr (ProbingPolicy::kUseControlBytes) {
+        set_ctrl(table, pos, get_tag(now.fingerprint));
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+void
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::erase_slot(
+    Table& table, size_t pos) {
+    table.slots[pos].id = kEmptySlot;
+    while (true) {
+        size_t nxt = table.growth.next_bucket(pos);
+        if (table.slots[nxt].id != kEmptySlot && table.slots[nxt].psl != 0) {
+            std::swap(table.slots[nxt], table.slots[pos]);
+            --table.slots[pos].psl;
+            if constexpr (ProbingPolicy::kUseControlBytes) {
+                set_ctrl(table, pos, table.ctrl[nxt]);
+            }
+            pos = nxt;
+        } else {
+            if constexpr (ProbingPolicy::kUseControlBytes) {
+                set_ctrl(table, pos, ProbingPolicy::kEmpty);
+            }
+            break;
+        }
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K>
+inline size_t
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::find_position(
+    const Table& table, const K& v, uint32_t fingerprint, size_t pos, uint32_t dist) const {
+    if (table.slots.empty()) {
+        record_lookup(false, 0);
+        return 0;
+    }
+    if constexpr (ProbingPolicy::kUseControlBytes) {
+        int8_t tag = get_tag(fingerprint);
+        size_t groups = 1;
+        while (true) {
+            const int8_t* group = table.ctrl.data() + pos;
+            uint32_t empty = ProbingPolicy::MatchEmpty(group);
+            uint32_t match = ProbingPolicy::Match(group, tag);
+            if (empty != 0) {
+                // Robin Hood clusters are contiguous: nothing past the first empty slot can match.
+                match &= (empty & (~empty + 1)) - 1;
+            }
+            while (match != 0) {
+                size_t cur = table.growth.next_bucket(pos, ProbingPolicy::LowestBit(match));
+                const Slot& slot = table.slots[cur];
+                if (slot.fingerprint == fingerprint && equal_(data_[slot.id].x_.first, v)) {  // NOLINT
+                    record_lookup(true, groups);
+                    return cur;
+                }
+                match &= match - 1;
+            }
+            if (empty != 0) {
+                record_lookup(false, groups);
+                return table.slots.size();
+            }
+            pos = table.growth.next_bucket(pos, ProbingPolicy::kGroupWidth);
+            ++groups;
+        }
+    } else {
+        // Robin Hood invariant: once the probe distance exceeds the resident's psl, the key
+        // would have displaced that resident on insertion, so it is not in the table.
+        uint32_t first = dist;
+        for (; table.slots[pos].id != kEmptySlot && table.slots[pos].psl >= dist; ++dist) {
+            const Slot& slot = table.slots[pos];
+            if (slot.psl == dist && slot.fingerprint == fingerprint &&  // NOLINT
+                equal_(data_[slot.id].x_.first, v)) {
+                record_lookup(true, dist - first + 1);
+                return pos;
+            }
+            pos = table.growth.next_bucket(pos);
+        }
+        record_lookup(false, dist - first + 1);
+        return table.slots.size();
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K>
+size_t
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::find_old_position(
+    const K& v, size_t hash, uint32_t fingerprint) const {
+    // Slots from migrate_start_ up to the cursor are already moved out, so a key whose home
+    // slot lies in that range can only be found from the cursor on.
+    size_t size = old_hash_map_.slots.size();
+    size_t pos = old_hash_map_.growth.bucket_for_hash(hash);
+    size_t offset = pos >= migrate_start_ ? pos - migrate_start_ : pos + size - migrate_start_;
+    uint32_t dist = 0;
+    if (offset < migrated_) {
+        dist = static_cast<uint32_t>(migrated_ - offset);
+        pos = old_hash_map_.growth.next_bucket(migrate_start_, migrated_);
+    }
+    return find_position(old_hash_map_, v, fingerprint, pos, dist);
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+template <class K>
+const typename HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::Slot*
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::find_slot(
+    const K& v, size_t hash) const {
+    uint32_t fingerprint = get_fingerprint(hash);
+    size_t pos = find_position(hash_map_, v, fingerprint, hash_map_.growth.bucket_for_hash(hash), 0);
+    if (pos != hash_map_.slots.size()) {
+        return &hash_map_.slots[pos];
+    }
+    if (!old_hash_map_.slots.empty()) {
+        pos = find_old_position(v, hash, fingerprint);
+        if (pos != old_hash_map_.slots.size()) {
+            return &old_hash_map_.slots[pos];
+        }
+    }
+    return nullptr;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>::operator=(
+    const HashMap& other) {
+    if (this != &other) {
+        *this = HashMap(other, AllocatorTraits::propagate_on_container_copy_assignment::value ? other.get_allocator()
+                                                                                             : get_allocator());
     }
     return (*this);
 }
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy,
+          class Allocator, class StoragePolicy>
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>&
+HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator,
+        StoragePolicy>::operator=(HashMap&& other) noexcept(kNothrowMoveAssignable) {
+    if (this == &other) {
+        return (*this);
+    }
+    max_load_factor_ = other.max_load_factor_;
+    incremental_rehash_ = other.incremental_rehash_;
+    hasher_ = std::move(other.hasher_);
+    equal_ = std::move(other.equal_);
+    data_ = std::move(other.data_);
+    hash_map_ = std::move(other.hash_map_);
+    old_hash_map_ = std::move(other.old_hash_map_);
+    migrate_start_ = other.migrate_start_;
+    migrated_ = other.migrated_;
+    // Moved one by one, the reserved capacity of a table in preparation would be lost, so it is
+    // started over instead.
+    next_hash_map_ = Table(get_allocator());
+#if defined(HASHMAP_ENABLE_STATS)
+    stats_counters_ = other.stats_counters_;
+    other.stats_counters_ = StatsCounters();
+#endif
+
+    // With allocators that neither propagate nor compare equal the elements were moved one by
+    // one and other still owns its arrays; they are released here.
+    other.data_ = NodeVector(other.data_.get_allocator());
+    other.hash_map_ = Table(other.get_allocator());
+    other.old_hash_map_ = Table(other.get_allocator());
+    other.next_hash_map_ = Table(other.get_allocator());
+    other.migrated_ = 0;
+    return (*this);
+}
+
+// HashMap hashing with FastHash (seed 0, or FastHash<KeyType>::Random() passed to the
+// constructor) where KeyType supports it:
+//
+//     FastHashMap<uint64_t, int> map;
+template <class KeyType, class ValueType, class Equal = std::equal_to<KeyType>, class ProbingPolicy = LinearProbing,
+          class GrowthPolicy = PowerOfTwoGrowthPolicy,
+          class Allocator = std::allocator<std::pair<const KeyType, ValueType>>,
+          class StoragePolicy = ContiguousStorage>
+using FastHashMap = HashMap<KeyType, ValueType, FastHashIfSupported<KeyType>, Equal, ProbingPolicy, GrowthPolicy,
+                            Allocator, StoragePolicy>;
+
+namespace pmr {
+
+// HashMap whose storage comes from a std::pmr::memory_resource, e.g. a per-request
+// std::pmr::monotonic_buffer_resource:
+//
+//     std::pmr::monotonic_buffer_resource arena;
+//     pmr::HashMap<int, int> map(&arena);
+template <class KeyType, class ValueType, class Hash = std::hash<KeyType>, class Equal = std::equal_to<KeyType>,
+          class ProbingPolicy = LinearProbing, class GrowthPolicy = PowerOfTwoGrowthPolicy,
+          class StoragePolicy = ContiguousStorage>
+using HashMap = ::HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy,
+                          std::pmr::polymorphic_allocator<std::pair<const KeyType, ValueType>>, StoragePolicy>;
+
+}  // namespace pmr
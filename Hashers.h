@@ -0,0 +1,445 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Hashers with a per-instance seed, for use as the Hash parameter of the maps in this library.
+//
+// std::hash of libstdc++ is the identity for integers, so keys sharing low bits (e.g. IDs that
+// are multiples of a large stride) are left for the table to spread. FastHash mixes integers
+// with a strong 64-bit bijection and hashes strings with a wyhash-style function; both take a
+// seed, and FastHash<T>::Random() picks a different one in every process:
+//
+//     HashMap<std::string, int, FastHash<std::string>> map(FastHash<std::string>::Random());
+//
+// A random seed keeps hash values and iteration order from being reproducible across runs, but
+// FastHash is built for speed, not as a keyed cryptographic function: it is not a defence
+// against an adversary crafting colliding keys (hash flooding). Maps fed with hostile keys
+// should use SipHash13, a keyed pseudorandom function with a 128-bit secret, instead:
+//
+//     HashMap<std::string, int, SipHash13<std::string>> map(SipHash13<std::string>::Random());
+//
+// The seed is part of the hasher, so copies of a map share it. A MappedHashMap must be opened
+// with the hasher, seed included, that the image was saved with.
+template <class T, class = void>
+struct FastHash {
+    static_assert(!std::is_same<T, T>::value,
+                  "FastHash supports integral, enum and pointer types, std::string and std::string_view");
+};
+
+// SipHash-1-3 (one compression and three finalization rounds, as in Rust's standard HashMap)
+// keyed by a 128-bit secret, for the same key types as FastHash. Without the secret an attacker
+// cannot predict which keys collide, so it is a defence against hash flooding as long as the
+// secret stays private: use Random(), not a fixed key. Several times slower than FastHash on
+// short keys.
+template <class T, class = void>
+struct SipHash13 {
+    static_assert(!std::is_same<T, T>::value,
+                  "SipHash13 supports integral, enum and pointer types, std::string and std::string_view");
+};
+
+// Holds for the key types FastHash and SipHash13 support.
+template <class T>
+struct IsFastHashable
+    : std::integral_constant<bool, std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value ||
+                                       std::is_same<T, std::string>::value ||
+                                       std::is_same<T, std::string_view>::value> {};
+
+// FastHash<T> for the key types it supports and std::hash<T> for the rest. The maps of this
+// library default to std::hash; FastHashMap (HashMap.h) is HashMap with this Hash instead. The
+// choice is made in the type, not by a macro, so that translation units built with different
+// flags cannot disagree on what HashMap<K, V> is.
+template <class T>
+using FastHashIfSupported = std::conditional_t<IsFastHashable<T>::value, FastHash<T>, std::hash<T>>;
+
+// A seed that differs between processes and between calls.
+inline uint64_t RandomHashSeed();
+
+// Strong 64-bit mixer (a bijection, so distinct integers keep distinct hashes).
+inline uint64_t MixInteger(uint64_t x, uint64_t seed);
+
+// Finalizer of MurmurHash3, an unseeded bijection in which every input bit affects every output
+// bit. Usable in constant expressions.
+constexpr uint64_t MurmurMix(uint64_t x);
+
+// The high 64 bits of the 128-bit product a * b. MultiplyHigh(x, n) maps a uniform x onto
+// [0, n) by its high bits (Lemire's fast range reduction), so the low bits stay free for
+// other uses.
+constexpr uint64_t MultiplyHigh(uint64_t a, uint64_t b);
+
+// wyhash-style hash of size bytes at data. Inputs longer than 48 bytes run through three
+// independent multiply lanes, so the loop is bound by multiplier throughput, not latency.
+// There is deliberately no SIMD path: the hash must not depend on compiler flags, since images
+// saved by one build are opened by others, and SSE2 has no 64-bit multiply, so a vectorizable
+// function (32x32-bit products, as in XXH3) is no faster under SSE2 and slower without it.
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed);
+
+// SipHash-1-3 of size bytes at data under the 128-bit key (key0, key1).
+inline uint64_t SipHashBytes(const void* data, size_t size, uint64_t key0, uint64_t key1);
+
+template <class T>
+struct FastHash<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>> {
+    FastHash();
+    explicit FastHash(uint64_t initial_seed);
+    static FastHash Random();  // NOLINT
+
+    size_t operator()(T value) const;
+
+    uint64_t seed;
+};
+
+// Hashes std::string, std::string_view and string literals alike, so with a transparent Equal
+// (e.g. std::equal_to<>) a map of std::string can be searched by std::string_view.
+template <class T>
+struct FastHash<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>> {
+    using is_transparent = void;
+
+    FastHash();
+    explicit FastHash(uint64_t initial_seed);
+    static FastHash Random();  // NOLINT
+
+    size_t operator()(std::string_view value) const;
+
+    uint64_t seed;
+};
+
+template <class T>
+struct SipHash13<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>> {
+    SipHash13();
+    SipHash13(uint64_t k0, uint64_t k1);
+    static SipHash13 Random();  // NOLINT
+
+    size_t operator()(T value) const;
+
+    uint64_t key0;
+    uint64_t key1;
+};
+
+// Transparent like the FastHash of strings.
+template <class T>
+struct SipHash13<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>> {
+    using is_transparent = void;
+
+    SipHash13();
+    SipHash13(uint64_t k0, uint64_t k1);
+    static SipHash13 Random();  // NOLINT
+
+    size_t operator()(std::string_view value) const;
+
+    uint64_t key0;
+    uint64_t key1;
+};
+
+namespace hashers_detail {
+
+#if defined(__SIZEOF_INT128__)
+// __extension__ keeps -Wpedantic quiet about the non-standard type.
+__extension__ typedef unsigned __int128 UInt128;
+#endif
+
+constexpr uint64_t kSecret[] = {0xA0761D6478BD642Full, 0xE7037ED1A0B428DBull, 0x8EBC6AF09C88C6E3ull,
+                                0x589965CC75374CC3ull};
+
+// XORs the low and high halves of a * b into a and b. Keeping the inputs (wyhash's "condom"
+// mode) means a zero factor, which an input word equal to a secret produces, cannot erase the
+// other factor and with it the seed and everything hashed so far.
+inline void Multiply(uint64_t& a, uint64_t& b) {
+#if defined(__SIZEOF_INT128__)
+    UInt128 product = static_cast<UInt128>(a) * b;
+    a ^= static_cast<uint64_t>(product);
+    b ^= static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t low = a * b;
+    b ^= MultiplyHigh(a, b);
+    a ^= low;
+#endif
+}
+
+// Folds a and b, together with their 128-bit product, into 64 bits.
+inline uint64_t Mix(uint64_t a, uint64_t b) {
+    Multiply(a, b);
+    return a ^ b;
+}
+
+inline uint64_t Read64(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t Read32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t RotateLeft(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+// One ARX round of SipHash over its four state words.
+inline void SipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+    v0 += v1;
+    v1 = RotateLeft(v1, 13) ^ v0;
+    v0 = RotateLeft(v0, 32);
+    v2 += v3;
+    v3 = RotateLeft(v3, 16) ^ v2;
+    v0 += v3;
+    v3 = RotateLeft(v3, 21) ^ v0;
+    v2 += v1;
+    v1 = RotateLeft(v1, 17) ^ v2;
+    v2 = RotateLeft(v2, 32);
+}
+
+}  // namespace hashers_detail
+
+inline uint64_t RandomHashSeed() {
+    // random_device alone may be deterministic on some platforms, so the clock and an address
+    // (randomized by ASLR) are mixed in as well.
+    static std::atomic<uint64_t> counter{0};
+    uint64_t seed = 0;
+    try {
+        std::random_device device;
+        seed = (static_cast<uint64_t>(device()) << 32) | device();
+    } catch (...) {
+        // Falls back to the other sources below.
+    }
+    seed ^= static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    seed ^= reinterpret_cast<uintptr_t>(&counter);
+    return MixInteger(counter.fetch_add(1, std::memory_order_relaxed), seed);
+}
+
+inline uint64_t MixInteger(uint64_t x, uint64_t seed) {
+    // moremur, an improved variant of the SplitMix64 finalizer, on the seeded input.
+    x ^= seed;
+    x ^= x >> 27;
+    x *= 0x3C79AC492BA7B653ull;
+    x ^= x >> 33;
+    x *= 0x1C69B3F74AC4AE35ull;
+    x ^= x >> 27;
+    return x;
+}
+
+constexpr uint64_t MurmurMix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+constexpr uint64_t MultiplyHigh(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    return static_cast<uint64_t>((static_cast<hashers_detail::UInt128>(a) * b) >> 64);
+#else
+    // Schoolbook multiplication of the 32-bit halves.
+    uint64_t lo = (a & 0xFFFFFFFFull) * (b & 0xFFFFFFFFull);
+    uint64_t mid1 = (a >> 32) * (b & 0xFFFFFFFFull);
+    uint64_t mid2 = (a & 0xFFFFFFFFull) * (b >> 32);
+    uint64_t carry = ((lo >> 32) + (mid1 & 0xFFFFFFFFull) + (mid2 & 0xFFFFFFFFull)) >> 32;
+    return (a >> 32) * (b >> 32) + (mid1 >> 32) + (mid2 >> 32) + carry;
+#endif
+}
+
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed) {
+    using hashers_detail::kSecret;
+    using hashers_detail::Mix;
+    using hashers_detail::Read32;
+    using hashers_detail::Read64;
+
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    seed ^= Mix(seed ^ kSecret[0], kSecret[1]);
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (size <= 16) {
+        if (size >= 4) {
+            // Two possibly overlapping 4-byte reads from each end cover every byte.
+            size_t middle = (size >> 3) << 2;
+            a = (Read32(p) << 32) | Read32(p + middle);
+            b = (Read32(p + size - 4) << 32) | Read32(p + size - 4 - middle);
+        } else if (size > 0) {
+            a = (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[size >> 1]) << 8) | p[size - 1];
+        }
+    } else {
+        size_t rest = size;
+        if (rest > 48) {
+            uint64_t lane1 = seed;
+            uint64_t lane2 = seed;
+            do {
+                seed = Mix(Read64(p) ^ kSecret[1], Read64(p + 8) ^ seed);
+                lane1 = Mix(Read64(p + 16) ^ kSecret[2], Read64(p + 24) ^ lane1);
+                lane2 = Mix(Read64(p + 32) ^ kSecret[3], Read64(p + 40) ^ lane2);
+                p += 48;
+                rest -= 48;
+            } while (rest > 48);
+            seed ^= lane1 ^ lane2;
+        }
+        while (rest > 16) {
+            seed = Mix(Read64(p) ^ kSecret[1], Read64(p + 8) ^ seed);
+            p += 16;
+            rest -= 16;
+        }
+        // The last 16 bytes, overlapping what was already consumed if rest < 16.
+        a = Read64(p + rest - 16);
+        b = Read64(p + rest - 8);
+    }
+    a ^= kSecret[1];
+    b ^= seed;
+    hashers_detail::Multiply(a, b);
+    return Mix(a ^ kSecret[0] ^ size, b ^ kSecret[1]);
+}
+
+inline uint64_t SipHashBytes(const void* data, size_t size, uint64_t key0, uint64_t key1) {
+    using hashers_detail::Read64;
+    using hashers_detail::SipRound;
+
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t v0 = key0 ^ 0x736F6D6570736575ull;
+    uint64_t v1 = key1 ^ 0x646F72616E646F6Dull;
+    uint64_t v2 = key0 ^ 0x6C7967656E657261ull;
+    uint64_t v3 = key1 ^ 0x7465646279746573ull;
+    size_t rest = size;
+    for (; rest >= 8; p += 8, rest -= 8) {
+        uint64_t word = Read64(p);
+        v3 ^= word;
+        SipRound(v0, v1, v2, v3);
+        v0 ^= word;
+    }
+    // The last word holds the remaining bytes and, in its top byte, the length.
+    uint64_t last = static_cast<uint64_t>(size) << 56;
+    for (size_t i = 0; i < rest; ++i) {
+        last |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    v3 ^= last;
+    SipRound(v0, v1, v2, v3);
+    v0 ^= last;
+    v2 ^= 0xFF;
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+template <class T>
+FastHash<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>>::
+    FastHash()
+    : seed(0) {
+}
+
+template <class T>
+FastHash<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>>::
+    FastHash(uint64_t initial_seed)
+    : seed(initial_seed) {
+}
+
+template <class T>
+FastHash<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>>
+FastHash<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>>::
+    Random() {
+    return FastHash(RandomHashSeed());
+}
+
+template <class T>
+size_t
+FastHash<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>>::
+operator()(T value) const {
+    if constexpr (std::is_pointer<T>::value) {
+        return static_cast<size_t>(MixInteger(reinterpret_cast<uintptr_t>(value), seed));
+    } else {
+        return static_cast<size_t>(MixInteger(static_cast<uint64_t>(value), seed));
+    }
+}
+
+template <class T>
+FastHash<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>>::
+    FastHash()
+    : seed(0) {
+}
+
+template <class T>
+FastHash<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>>::
+    FastHash(uint64_t initial_seed)
+    : seed(initial_seed) {
+}
+
+template <class T>
+FastHash<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>>
+FastHash<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>>::
+    Random() {
+    return FastHash(RandomHashSeed());
+}
+
+template <class T>
+size_t
+FastHash<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>>::
+operator()(std::string_view value) const {
+    return static_cast<size_t>(HashBytes(value.data(), value.size(), seed));
+}
+
+template <class T>
+SipHash13<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>>::
+    SipHash13()
+    : key0(0), key1(0) {
+}
+
+template <class T>
+SipHash13<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>>::
+    SipHash13(uint64_t k0, uint64_t k1)
+    : key0(k0), key1(k1) {
+}
+
+template <class T>
+SipHash13<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>>
+SipHash13<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>>::
+    Random() {
+    uint64_t k0 = RandomHashSeed();
+    return SipHash13(k0, RandomHashSeed());
+}
+
+template <class T>
+size_t
+SipHash13<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>>::
+operator()(T value) const {
+    uint64_t word;
+    if constexpr (std::is_pointer<T>::value) {
+        word = reinterpret_cast<uintptr_t>(value);
+    } else {
+        word = static_cast<uint64_t>(value);
+    }
+    return static_cast<size_t>(SipHashBytes(&word, sizeof(word), key0, key1));
+}
+
+template <class T>
+SipHash13<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>>::
+    SipHash13()
+    : key0(0), key1(0) {
+}
+
+template <class T>
+SipHash13<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>>::
+    SipHash13(uint64_t k0, uint64_t k1)
+    : key0(k0), key1(k1) {
+}
+
+template <class T>
+SipHash13<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>>
+SipHash13<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>>::
+    Random() {
+    uint64_t k0 = RandomHashSeed();
+    return SipHash13(k0, RandomHashSeed());
+}
+
+template <class T>
+size_t
+SipHash13<T, std::enable_if_t<std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value>>::
+operator()(std::string_view value) const {
+    return static_cast<size_t>(SipHashBytes(value.data(), value.size(), key0, key1));
+}
@@ -0,0 +1,539 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "HashMap.h"
+
+// How a key or value type is laid out in a MappedHashMap image. Trivially copyable types are
+// stored as they are and read back by reference; other types need a specialization.
+template <class T, class = void>
+struct MappedCodec {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "MappedHashMap stores trivially copyable types and std::string only");
+};
+
+template <class T>
+struct MappedCodec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>> {
+    using Stored = T;
+    using View = const T&;
+
+    // Returns the record for value, reserving its bytes in the string area from blob_size on.
+    static Stored encode(const T& value, uint64_t& blob_size);
+    // Appends the bytes reserved by encode to the string area.
+    static void write_blob(const T& value, std::ostream& out);
+    static View decode(const Stored& stored, const char* blob);
+    // Whether decoding stored stays inside a string area of blob_size bytes.
+    static bool fits(const Stored& stored, uint64_t blob_size);
+};
+
+// Strings are stored as an (offset, size) record pointing into the string area of the image.
+template <>
+struct MappedCodec<std::string> {
+    struct Stored {
+        uint64_t offset;
+        uint64_t size;
+    };
+    using View = std::string_view;
+
+    static Stored encode(const std::string& value, uint64_t& blob_size);
+    static void write_blob(const std::string& value, std::ostream& out);
+    static View decode(const Stored& stored, const char* blob);
+    static bool fits(const Stored& stored, uint64_t blob_size);
+};
+
+// Read-only view of a HashMap image written by HashMap::save. The image is mapped with mmap and
+// lookups run directly on it, so opening takes constant time regardless of the table size,
+// pages are loaded on first access and shared between all processes mapping the same file.
+// Saving over an open image replaces the file rather than rewriting it, so maps already open
+// keep serving the old image.
+//
+// The image keeps the slot array of the saved table (ids, probe sequence lengths and
+// fingerprints), the entries in one contiguous array and the contents of std::string keys and
+// values in a separate area. Hash and GrowthPolicy must be the ones the table was saved with
+// and Hash must give the same values in the reading process; keys are compared with ==.
+//
+// Opening checks the header and that every section lies inside the file, but not the slots and
+// entries themselves: reading them all would load the whole image. A corrupt image can then make
+// lookups and iteration read outside the mapping, so images from untrusted sources should be
+// checked with verify() right after opening.
+//
+// Requires POSIX mmap.
+template <class KeyType, class ValueType, class Hash = std::hash<KeyType>, class GrowthPolicy = PowerOfTwoGrowthPolicy>
+class MappedHashMap {
+private:
+    using KeyCodec = MappedCodec<KeyType>;
+    using ValueCodec = MappedCodec<ValueType>;
+
+    struct Entry {
+        typename KeyCodec::Stored key;
+        typename ValueCodec::Stored value;
+    };
+
+    // Same 8-byte layout as HashMap's slots.
+    struct Slot {
+        uint32_t id;
+        uint32_t psl : 24;
+        uint32_t fingerprint : 8;
+    };
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t entry_size;
+        uint64_t size;
+        uint64_t bucket_count;
+        uint64_t growth_check;
+        uint64_t slots_offset;
+        uint64_t entries_offset;
+        uint64_t blob_offset;
+        uint64_t file_size;
+    };
+
+    static constexpr uint64_t kMagic = 0x31474D4950414D48ull;  // "HMAPIMG1"
+    static constexpr uint32_t kVersion = 2;
+    static constexpr uint32_t kEmptySlot = static_cast<uint32_t>(-1);
+    static constexpr uint64_t kSectionAlignment = 64;
+
+public:
+    using KeyView = typename KeyCodec::View;
+    using ValueView = typename ValueCodec::View;
+
+    class const_iterator {
+    public:
+        const_iterator();
+        const_iterator(const MappedHashMap* owner, size_t id);
+
+        std::pair<KeyView, ValueView> operator*() const;
+
+        // Holds the pair operator-> points to, since it is built on the fly.
+        struct Arrow {
+            std::pair<KeyView, ValueView> value;
+            const std::pair<KeyView, ValueView>* operator->() const;
+        };
+        Arrow operator->() const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+
+        bool operator==(const const_iterator& other) const;
+        bool operator!=(const const_iterator& other) const;
+
+    private:
+        const MappedHashMap* owner_;
+        size_t id_;
+    };
+
+    // Maps the image at path. Throws std::runtime_error if it cannot be opened or was not
+    // written for this key, value and growth policy layout.
+    explicit MappedHashMap(const std::string& path, Hash hasher = Hash());
+    MappedHashMap(MappedHashMap&& other);
+    MappedHashMap(const MappedHashMap&) = delete;
+    MappedHashMap& operator=(const MappedHashMap&) = delete;
+    ~MappedHashMap();
+
+    // Writes the image of map to path; see HashMap::save.
+    template <class Equal, class ProbingPolicy, class Allocator, class StoragePolicy>
+    static void save(  // NOLINT
+        const HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>& map,
+        const std::string& path);
+
+    size_t size() const;          // NOLINT
+    bool empty() const;           // NOLINT
+    size_t bucket_count() const;  // NOLINT
+
+    const_iterator begin() const;  // NOLINT
+    const_iterator end() const;    // NOLINT
+
+    const_iterator find(const KeyType& key) const;  // NOLINT
+    bool contains(const KeyType& key) const;        // NOLINT
+    size_t count(const KeyType& key) const;         // NOLINT
+    ValueView at(const KeyType& key) const;         // NOLINT
+
+    // Checks that every slot refers to an entry and every string lies inside the string area,
+    // in one pass over the whole image. Throws std::runtime_error if the image is corrupt.
+    void verify() const;  // NOLINT
+
+private:
+    Hash hasher_;
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    GrowthPolicy growth_;
+    const Header* header_ = nullptr;
+    const Slot* slots_ = nullptr;
+    const Entry* entries_ = nullptr;
+    const char* blob_ = nullptr;
+
+    void validate(const std::string& path) const;  // NOLINT
+
+    static uint64_t align_section(uint64_t offset);  // NOLINT
+    // Digest of where GrowthPolicy sends a few fixed hashes, so an image saved with another
+    // growth policy of the same bucket count is rejected as well.
+    static uint64_t get_growth_check(const GrowthPolicy& growth);  // NOLINT
+};
+
+template <class T>
+typename MappedCodec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>>::Stored
+MappedCodec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>>::encode(const T& value, uint64_t&) {
+    return value;
+}
+
+template <class T>
+void MappedCodec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>>::write_blob(const T&, std::ostream&) {
+}
+
+template <class T>
+typename MappedCodec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>>::View
+MappedCodec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>>::decode(const Stored& stored, const char*) {
+    return stored;
+}
+
+template <class T>
+bool MappedCodec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>>::fits(const Stored&, uint64_t) {
+    return true;
+}
+
+inline MappedCodec<std::string>::Stored MappedCodec<std::string>::encode(const std::string& value,
+                                                                         uint64_t& blob_size) {
+    Stored stored{blob_size, value.size()};
+    blob_size += value.size();
+    return stored;
+}
+
+inline void MappedCodec<std::string>::write_blob(const std::string& value, std::ostream& out) {
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+inline MappedCodec<std::string>::View MappedCodec<std::string>::decode(const Stored& stored, const char* blob) {
+    return View(blob + stored.offset, stored.size);
+}
+
+inline bool MappedCodec<std::string>::fits(const Stored& stored, uint64_t blob_size) {
+    return stored.offset <= blob_size && stored.size <= blob_size - stored.offset;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator::const_iterator() : owner_(nullptr), id_(0) {
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator::const_iterator(const MappedHashMap* owner,
+                                                                                      size_t id)
+    : owner_(owner), id_(id) {
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+std::pair<typename MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::KeyView,
+          typename MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::ValueView>
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator::operator*() const {
+    const Entry& entry = owner_->entries_[id_];
+    return {KeyCodec::decode(entry.key, owner_->blob_), ValueCodec::decode(entry.value, owner_->blob_)};
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+const std::pair<typename MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::KeyView,
+                typename MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::ValueView>*
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator::Arrow::operator->() const {
+    return &value;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+typename MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator::Arrow
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator::operator->() const {
+    return Arrow{**this};
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+typename MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator&
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator::operator++() {
+    ++id_;
+    return *this;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+typename MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator::operator++(int) {
+    const_iterator tmp = *this;
+    ++id_;
+    return tmp;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+bool MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator::operator==(
+    const const_iterator& other) const {
+    return id_ == other.id_;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+bool MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator::operator!=(
+    const const_iterator& other) const {
+    return id_ != other.id_;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::MappedHashMap(const std::string& path, Hash hasher)
+    : hasher_(hasher) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("MappedHashMap: cannot open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error("MappedHashMap: " + path + " is not a HashMap image");
+    }
+    mapping_size_ = static_cast<size_t>(st.st_size);
+    mapping_ = ::mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping_ == MAP_FAILED) {
+        mapping_ = nullptr;
+        throw std::runtime_error("MappedHashMap: cannot map " + path);
+    }
+    // Lookups touch one slot and one entry at random, so read-ahead would only waste I/O.
+    ::madvise(mapping_, mapping_size_, MADV_RANDOM);
+
+    const char* base = static_cast<const char*>(mapping_);
+    header_ = reinterpret_cast<const Header*>(base);
+    try {
+        validate(path);
+    } catch (...) {
+        ::munmap(mapping_, mapping_size_);
+        throw;
+    }
+    growth_ = GrowthPolicy(header_->bucket_count);
+    slots_ = reinterpret_cast<const Slot*>(base + header_->slots_offset);
+    entries_ = reinterpret_cast<const Entry*>(base + header_->entries_offset);
+    blob_ = base + header_->blob_offset;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::MappedHashMap(MappedHashMap&& other)
+    : hasher_(std::move(other.hasher_)),
+      mapping_(other.mapping_),
+      mapping_size_(other.mapping_size_),
+      growth_(other.growth_),
+      header_(other.header_),
+      slots_(other.slots_),
+      entries_(other.entries_),
+      blob_(other.blob_) {
+    other.mapping_ = nullptr;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::~MappedHashMap() {
+    if (mapping_ != nullptr) {
+        ::munmap(mapping_, mapping_size_);
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+template <class Equal, class ProbingPolicy, class Allocator, class StoragePolicy>
+void MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::save(
+    const HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>& map,
+    const std::string& path) {
+    using Map = HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy, Allocator, StoragePolicy>;
+    if (!map.old_hash_map_.slots.empty() || map.hash_map_.slots.empty()) {
+        // The image has a single slot array, so an incremental rehash has to be finished first,
+        // and a map that has not allocated its slots yet gets them.
+        Map copy(map);
+        copy.finish_migration();
+        if (copy.hash_map_.slots.empty()) {
+            copy.Build(0);
+        }
+        save(copy, path);
+        return;
+    }
+
+    Header header;
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.entry_size = sizeof(Entry);
+    header.size = map.data_.size();
+    header.bucket_count = map.hash_map_.slots.size();
+    header.growth_check = get_growth_check(map.hash_map_.growth);
+    header.slots_offset = align_section(sizeof(Header));
+    header.entries_offset = align_section(header.slots_offset + header.bucket_count * sizeof(Slot));
+    header.blob_offset = align_section(header.entries_offset + header.size * sizeof(Entry));
+
+    // Processes may have the current image at path mapped, so it is never rewritten in place:
+    // the new image goes to a temporary file that replaces path in a single rename, and the old
+    // file lives on, unchanged, until its last mapping is gone.
+    const std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("MappedHashMap: cannot create " + temporary);
+    }
+    const char padding[kSectionAlignment] = {};
+    auto pad_to = [&out, &padding](uint64_t offset) {
+        out.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(out.tellp())));
+    };
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    pad_to(header.slots_offset);
+    for (const auto& slot : map.hash_map_.slots) {
+        Slot image{slot.id, slot.psl, slot.fingerprint};
+        out.write(reinterpret_cast<const char*>(&image), sizeof(Slot));
+    }
+    pad_to(header.entries_offset);
+    uint64_t blob_size = 0;
+    for (size_t id = 0; id < map.data_.size(); ++id) {
+        const auto& node = map.data_[id];
+        Entry entry;
+        std::memset(&entry, 0, sizeof(Entry));
+        entry.key = KeyCodec::encode(node.x_.first, blob_size);
+        entry.value = ValueCodec::encode(node.x_.second, blob_size);
+        out.write(reinterpret_cast<const char*>(&entry), sizeof(Entry));
+    }
+    pad_to(header.blob_offset);
+    for (size_t id = 0; id < map.data_.size(); ++id) {
+        const auto& node = map.data_[id];
+        KeyCodec::write_blob(node.x_.first, out);
+        ValueCodec::write_blob(node.x_.second, out);
+    }
+
+    header.file_size = header.blob_offset + blob_size;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    out.close();
+    // The data must be on disk before the rename publishes it, or a crash could leave path
+    // naming a partly written image.
+    int fd = out ? ::open(temporary.c_str(), O_WRONLY) : -1;
+    bool synced = fd >= 0 && ::fsync(fd) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!synced || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("MappedHashMap: cannot write " + path);
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+size_t MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::size() const {
+    return header_->size;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+bool MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::empty() const {
+    return header_->size == 0;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+size_t MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::bucket_count() const {
+    return header_->bucket_count;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+typename MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::begin() const {
+    return const_iterator(this, 0);
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+typename MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::end() const {
+    return const_iterator(this, header_->size);
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+typename MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::const_iterator
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::find(const KeyType& key) const {
+    size_t hash = hasher_(key);
+    // Same fingerprint and probe order as the HashMap the image was saved from.
+    uint32_t fingerprint = HashMap<KeyType, ValueType, Hash>::get_fingerprint(hash);
+    size_t pos = growth_.bucket_for_hash(hash);
+    for (uint32_t dist = 0; slots_[pos].id != kEmptySlot && slots_[pos].psl >= dist; ++dist) {
+        const Slot& slot = slots_[pos];
+        if (slot.psl == dist && slot.fingerprint == fingerprint &&
+            KeyCodec::decode(entries_[slot.id].key, blob_) == key) {
+            return const_iterator(this, slot.id);
+        }
+        pos = growth_.next_bucket(pos);
+    }
+    return end();
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+bool MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::contains(const KeyType& key) const {
+    return find(key) != end();
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+size_t MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::count(const KeyType& key) const {
+    return contains(key) ? 1 : 0;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+typename MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::ValueView
+MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::at(const KeyType& key) const {
+    const_iterator it = find(key);
+    if (it == end()) {
+        throw std::out_of_range("no such key in MappedHashMap");
+    }
+    return (*it).second;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+void MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::validate(const std::string& path) const {
+    const Header& header = *header_;
+    if (header.magic != kMagic || header.version != kVersion) {
+        throw std::runtime_error("MappedHashMap: " + path + " is not a HashMap image");
+    }
+    GrowthPolicy growth(header.bucket_count);
+    if (header.entry_size != sizeof(Entry) || growth.bucket_count() != header.bucket_count ||
+        get_growth_check(growth) != header.growth_check) {
+        throw std::runtime_error("MappedHashMap: " + path + " was saved with a different key, value or growth policy");
+    }
+    // Counts are compared by division, so that no crafted header can overflow the bounds.
+    auto inside = [this](uint64_t offset, uint64_t count, uint64_t element_size) {
+        return offset % kSectionAlignment == 0 && offset <= mapping_size_ &&
+               count <= (mapping_size_ - offset) / element_size;
+    };
+    if (header.file_size != mapping_size_ || header.size >= kEmptySlot ||
+        !inside(header.slots_offset, header.bucket_count, sizeof(Slot)) ||
+        !inside(header.entries_offset, header.size, sizeof(Entry)) || !inside(header.blob_offset, 0, 1)) {
+        throw std::runtime_error("MappedHashMap: " + path + " is truncated or corrupt");
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+void MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::verify() const {
+    for (size_t pos = 0; pos < header_->bucket_count; ++pos) {
+        if (slots_[pos].id != kEmptySlot && slots_[pos].id >= header_->size) {
+            throw std::runtime_error("MappedHashMap: slot " + std::to_string(pos) + " refers to no entry");
+        }
+    }
+    uint64_t blob_size = header_->file_size - header_->blob_offset;
+    for (size_t id = 0; id < header_->size; ++id) {
+        if (!KeyCodec::fits(entries_[id].key, blob_size) || !ValueCodec::fits(entries_[id].value, blob_size)) {
+            throw std::runtime_error("MappedHashMap: entry " + std::to_string(id) + " lies outside the string area");
+        }
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+uint64_t MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::align_section(uint64_t offset) {
+    return (offset + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+}
+
+template <class KeyType, class ValueType, class Hash, class GrowthPolicy>
+uint64_t MappedHashMap<KeyType, ValueType, Hash, GrowthPolicy>::get_growth_check(const GrowthPolicy& growth) {
+    uint64_t check = 0;
+    for (uint64_t i = 1; i <= 8; ++i) {
+        check = check * 31 + growth.bucket_for_hash(static_cast<size_t>(i * 0x9E3779B97F4A7C15ull));
+        check = check * 31 + growth.next_bucket(static_cast<size_t>(i % growth.bucket_count()));
+    }
+    return check;
+}
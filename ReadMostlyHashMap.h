@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "HashMap.h"
+
+// Map for tables that are read far more often than they change. Readers look up in an
+// immutable published HashMap without taking locks: entering a read only stores the current
+// epoch into the reader's own cache line and loads the published pointer. Writers are
+// serialized, apply a whole batch of mutations to a private copy of the table and publish it
+// with one pointer swap. A replaced table is freed once no reader is still inside an epoch
+// that could have observed it (epoch-based reclamation).
+//
+//     ReadMostlyHashMap<std::string, Route> routes;
+//     auto reader = routes.reader();  // once per reading thread
+//     {
+//         auto snapshot = reader.pin();
+//         auto it = snapshot->find(key);
+//         ...                          // it stays valid until snapshot is destroyed
+//     }
+//     routes.update([](auto& map) { map.insert_or_assign(key, route); });
+template <class KeyType, class ValueType, class Hash = std::hash<KeyType>, class Equal = std::equal_to<KeyType>,
+          class ProbingPolicy = LinearProbing, class GrowthPolicy = PowerOfTwoGrowthPolicy>
+class ReadMostlyHashMap {
+private:
+    // Epoch a reader entered, or kQuiescent while it holds no snapshot. Aligned to a cache line
+    // so that readers never write to a line another thread reads on its hot path.
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch;
+        bool in_use;
+    };
+
+    static constexpr uint64_t kQuiescent = 0;
+
+public:
+    using Map = HashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>;
+
+    // A pinned table. The table and all iterators into it stay valid while the Snapshot lives;
+    // updates published meanwhile are not visible through it.
+    class Snapshot {
+    public:
+        Snapshot(Snapshot&& other);
+        Snapshot& operator=(const Snapshot&) = delete;
+        ~Snapshot();
+
+        const Map& operator*() const;
+        const Map* operator->() const;
+
+    private:
+        friend class ReadMostlyHashMap;
+
+        Snapshot(ReaderSlot* slot, const Map* map);
+
+        ReaderSlot* slot_;
+        const Map* map_;
+    };
+
+    // Registration of one reading thread. A Reader must only be used by one thread at a time
+    // and holds at most one Snapshot at a time; it must not outlive the map.
+    class Reader {
+    public:
+        Reader(Reader&& other);
+        Reader& operator=(const Reader&) = delete;
+        ~Reader();
+
+        Snapshot pin() const;  // NOLINT
+
+    private:
+        friend class ReadMostlyHashMap;
+
+        Reader(const ReadMostlyHashMap* owner, ReaderSlot* slot);
+
+        const ReadMostlyHashMap* owner_;
+        ReaderSlot* slot_;
+    };
+
+    explicit ReadMostlyHashMap(Hash hasher = Hash(), Equal equal = Equal());
+    explicit ReadMostlyHashMap(Map map);
+    ReadMostlyHashMap(const ReadMostlyHashMap&) = delete;
+    ReadMostlyHashMap& operator=(const ReadMostlyHashMap&) = delete;
+    // All Readers must have been destroyed before the map.
+    ~ReadMostlyHashMap() = default;
+
+    Reader reader() const;  // NOLINT
+
+    // Copies the current table, calls mutate(Map&) on the copy and publishes the result.
+    // Writers are serialized; a batch of changes should go into one call, since every call
+    // copies the whole table.
+    template <class Mutate>
+    void update(Mutate&& mutate);  // NOLINT
+    // Publishes map in place of the current table.
+    void publish(Map map);  // NOLINT
+
+    // Frees the replaced tables no reader can still see. Called by every update and publish,
+    // so it is only needed to release memory early once readers have left old snapshots.
+    void reclaim();  // NOLINT
+
+    // Number of replaced tables that are still waiting for readers to leave them.
+    size_t retired_count() const;  // NOLINT
+
+private:
+    void publish_locked(std::unique_ptr<const Map> map);  // NOLINT
+    void reclaim_locked();                                // NOLINT
+
+    std::atomic<const Map*> current_;
+    std::atomic<uint64_t> epoch_;
+
+    // Serializes writers and guards retired_.
+    mutable std::mutex write_mutex_;
+    std::unique_ptr<const Map> current_owner_;
+    // Replaced tables with the last epoch in which a reader could have loaded them.
+    std::vector<std::pair<uint64_t, std::unique_ptr<const Map>>> retired_;
+
+    // Guards registration of readers; slots are never deallocated before the map itself.
+    mutable std::mutex readers_mutex_;
+    mutable std::list<ReaderSlot> readers_;
+};
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Snapshot::Snapshot(ReaderSlot* slot,
+                                                                                                    const Map* map)
+    : slot_(slot), map_(map) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Snapshot::Snapshot(Snapshot&& other)
+    : slot_(other.slot_), map_(other.map_) {
+    other.slot_ = nullptr;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Snapshot::~Snapshot() {
+    if (slot_ != nullptr) {
+        slot_->epoch.store(kQuiescent, std::memory_order_release);
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+const typename ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Map&
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Snapshot::operator*() const {
+    return *map_;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+const typename ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Map*
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Snapshot::operator->() const {
+    return map_;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Reader::Reader(
+    const ReadMostlyHashMap* owner, ReaderSlot* slot)
+    : owner_(owner), slot_(slot) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Reader::Reader(Reader&& other)
+    : owner_(other.owner_), slot_(other.slot_) {
+    other.slot_ = nullptr;
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Reader::~Reader() {
+    if (slot_ != nullptr) {
+        std::lock_guard<std::mutex> lock(owner_->readers_mutex_);
+        slot_->in_use = false;
+    }
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+typename ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Snapshot
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Reader::pin() const {
+    // The epoch store must be visible before the table is loaded, otherwise a writer could
+    // replace and free the table in between without seeing this reader. Both are seq_cst.
+    slot_->epoch.store(owner_->epoch_.load(std::memory_order_acquire), std::memory_order_seq_cst);
+    return Snapshot(slot_, owner_->current_.load(std::memory_order_seq_cst));
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::ReadMostlyHashMap(Hash hasher,
+                                                                                                   Equal equal)
+    : ReadMostlyHashMap(Map(hasher, equal)) {
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::ReadMostlyHashMap(Map map)
+    : epoch_(1), current_owner_(new Map(std::move(map))) {
+    current_.store(current_owner_.get());
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+typename ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::Reader
+ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::reader() const {
+    std::lock_guard<std::mutex> lock(readers_mutex_);
+    for (ReaderSlot& slot : readers_) {
+        if (!slot.in_use) {
+            slot.in_use = true;
+            return Reader(this, &slot);
+        }
+    }
+    readers_.emplace_back();
+    readers_.back().epoch.store(kQuiescent);
+    readers_.back().in_use = true;
+    return Reader(this, &readers_.back());
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+template <class Mutate>
+void ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::update(Mutate&& mutate) {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    std::unique_ptr<Map> next(new Map(*current_owner_));
+    mutate(*next);
+    publish_locked(std::move(next));
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+void ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::publish(Map map) {
+    std::unique_ptr<const Map> next(new Map(std::move(map)));
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    publish_locked(std::move(next));
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+void ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::reclaim() {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    reclaim_locked();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+size_t ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::retired_count() const {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return retired_.size();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+void ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::publish_locked(
+    std::unique_ptr<const Map> map) {
+    current_.store(map.get(), std::memory_order_seq_cst);
+    // A reader that loads the table from now on has entered epoch retired_epoch + 1 or has
+    // stored retired_epoch before the store above, so scanning the slots will find it.
+    uint64_t retired_epoch = epoch_.fetch_add(1, std::memory_order_seq_cst);
+    retired_.emplace_back(retired_epoch, std::move(current_owner_));
+    current_owner_ = std::move(map);
+    reclaim_locked();
+}
+
+template <class KeyType, class ValueType, class Hash, class Equal, class ProbingPolicy, class GrowthPolicy>
+void ReadMostlyHashMap<KeyType, ValueType, Hash, Equal, ProbingPolicy, GrowthPolicy>::reclaim_locked() {
+    if (retired_.empty()) {
+        return;
+    }
+    uint64_t oldest = static_cast<uint64_t>(-1);
+    {
+        std::lock_guard<std::mutex> lock(readers_mutex_);
+        for (const ReaderSlot& slot : readers_) {
+            uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+            if (epoch != kQuiescent) {
+                oldest = std::min(oldest, epoch);
+            }
+        }
+    }
+    // retired_ is ordered by epoch, so the freeable tables form a prefix.
+    size_t freed = 0;
+    while (freed < retired_.size() && retired_[freed].first < oldest) {
+        ++freed;
+    }
+    retired_.erase(retired_.begin(), retired_.begin() + freed);
+}
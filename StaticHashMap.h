@@ -0,0 +1,194 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "Hashers.h"
+
+// Hash usable in constant expressions, for StaticHashMap. Integral and enum keys go through
+// MurmurMix, string keys (as std::string_view, which string literals convert to) through FNV-1a
+// followed by MurmurMix.
+template <class T, class = void>
+struct ConstexprHash {
+    static_assert(!std::is_same<T, T>::value, "ConstexprHash supports integral, enum and std::string_view keys");
+};
+
+template <class T>
+struct ConstexprHash<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value>> {
+    constexpr size_t operator()(T value) const;
+};
+
+template <>
+struct ConstexprHash<std::string_view> {
+    constexpr size_t operator()(std::string_view value) const;
+};
+
+// Map over a fixed set of keys whose whole layout is computed at compile time. Defined as a
+// constexpr variable, e.g.
+//
+//     static constexpr auto kMethods = MakeStaticHashMap<std::string_view, int>({{"GET", 1}, {"PUT", 2}});
+//
+// it lives in read-only data: nothing is allocated or run at startup, and lookups of constant
+// keys can be folded by the compiler.
+//
+// The entries keep the order they were given in, which is also the iteration order. The bucket
+// array holds the entry indices, has a power-of-two size of at least 2 * N and is searched with
+// linear probing. Duplicate keys are a compile error when the map is built in a constant
+// expression, and std::invalid_argument otherwise.
+template <class KeyType, class ValueType, size_t N, class Hash = ConstexprHash<KeyType>,
+          class Equal = std::equal_to<KeyType>>
+class StaticHashMap {
+public:
+    using value_type = std::pair<const KeyType, ValueType>;
+    using const_iterator = const value_type*;
+    using iterator = const_iterator;
+
+    constexpr explicit StaticHashMap(const std::pair<KeyType, ValueType> (&entries)[N], Hash hasher = Hash(),
+                                     Equal equal = Equal());
+
+    constexpr size_t size() const;          // NOLINT
+    constexpr bool empty() const;           // NOLINT
+    constexpr size_t bucket_count() const;  // NOLINT
+
+    constexpr const_iterator begin() const;  // NOLINT
+    constexpr const_iterator end() const;    // NOLINT
+
+    constexpr const_iterator find(const KeyType& key) const;  // NOLINT
+    constexpr bool contains(const KeyType& key) const;        // NOLINT
+    constexpr size_t count(const KeyType& key) const;         // NOLINT
+    // Throws std::out_of_range if key is absent, which is a compile error in a constant expression.
+    constexpr const ValueType& at(const KeyType& key) const;  // NOLINT
+
+private:
+    static constexpr size_t kBucketCount = [] {
+        size_t count = 2;
+        while (count < 2 * N) {
+            count *= 2;
+        }
+        return count;
+    }();
+    static constexpr uint32_t kEmptySlot = static_cast<uint32_t>(-1);
+
+    template <size_t... I>
+    constexpr StaticHashMap(const std::pair<KeyType, ValueType> (&entries)[N], Hash hasher, Equal equal,
+                            std::index_sequence<I...>);
+
+    Hash hasher_;
+    Equal equal_;
+    std::array<value_type, N> entries_;
+    std::array<uint32_t, kBucketCount> slots_;
+
+    constexpr size_t find_position(const KeyType& key) const;  // NOLINT
+};
+
+template <class KeyType, class ValueType, size_t N>
+constexpr StaticHashMap<KeyType, ValueType, N> MakeStaticHashMap(const std::pair<KeyType, ValueType> (&entries)[N]) {
+    return StaticHashMap<KeyType, ValueType, N>(entries);
+}
+
+template <class T>
+constexpr size_t
+ConstexprHash<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value>>::operator()(T value) const {
+    return static_cast<size_t>(MurmurMix(static_cast<uint64_t>(value)));
+}
+
+constexpr size_t ConstexprHash<std::string_view>::operator()(std::string_view value) const {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (char c : value) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    }
+    return static_cast<size_t>(MurmurMix(hash));
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+constexpr StaticHashMap<KeyType, ValueType, N, Hash, Equal>::StaticHashMap(
+    const std::pair<KeyType, ValueType> (&entries)[N], Hash hasher, Equal equal)
+    : StaticHashMap(entries, hasher, equal, std::make_index_sequence<N>()) {
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+template <size_t... I>
+constexpr StaticHashMap<KeyType, ValueType, N, Hash, Equal>::StaticHashMap(
+    const std::pair<KeyType, ValueType> (&entries)[N], Hash hasher, Equal equal, std::index_sequence<I...>)
+    : hasher_(hasher), equal_(equal), entries_{{value_type(entries[I].first, entries[I].second)...}}, slots_{} {
+    for (size_t pos = 0; pos < kBucketCount; ++pos) {
+        slots_[pos] = kEmptySlot;
+    }
+    for (size_t id = 0; id < N; ++id) {
+        size_t pos = find_position(entries_[id].first);
+        if (slots_[pos] != kEmptySlot) {
+            throw std::invalid_argument("StaticHashMap: duplicate key");
+        }
+        slots_[pos] = static_cast<uint32_t>(id);
+    }
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+constexpr size_t StaticHashMap<KeyType, ValueType, N, Hash, Equal>::size() const {
+    return N;
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+constexpr bool StaticHashMap<KeyType, ValueType, N, Hash, Equal>::empty() const {
+    return N == 0;
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+constexpr size_t StaticHashMap<KeyType, ValueType, N, Hash, Equal>::bucket_count() const {
+    return kBucketCount;
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+constexpr typename StaticHashMap<KeyType, ValueType, N, Hash, Equal>::const_iterator
+StaticHashMap<KeyType, ValueType, N, Hash, Equal>::begin() const {
+    return entries_.data();
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+constexpr typename StaticHashMap<KeyType, ValueType, N, Hash, Equal>::const_iterator
+StaticHashMap<KeyType, ValueType, N, Hash, Equal>::end() const {
+    return entries_.data() + N;
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+constexpr typename StaticHashMap<KeyType, ValueType, N, Hash, Equal>::const_iterator
+StaticHashMap<KeyType, ValueType, N, Hash, Equal>::find(const KeyType& key) const {
+    uint32_t id = slots_[find_position(key)];
+    return id == kEmptySlot ? end() : begin() + id;
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+constexpr bool StaticHashMap<KeyType, ValueType, N, Hash, Equal>::contains(const KeyType& key) const {
+    return find(key) != end();
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+constexpr size_t StaticHashMap<KeyType, ValueType, N, Hash, Equal>::count(const KeyType& key) const {
+    return contains(key) ? 1 : 0;
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+constexpr const ValueType& StaticHashMap<KeyType, ValueType, N, Hash, Equal>::at(const KeyType& key) const {
+    const_iterator it = find(key);
+    if (it == end()) {
+        throw std::out_of_range("no such key in StaticHashMap");
+    }
+    return it->second;
+}
+
+template <class KeyType, class ValueType, size_t N, class Hash, class Equal>
+constexpr size_t StaticHashMap<KeyType, ValueType, N, Hash, Equal>::find_position(const KeyType& key) const {
+    // The slot holding key, or the empty slot that ends its probe sequence. At most half of the
+    // slots are used, so the sequence always ends.
+    size_t pos = static_cast<size_t>(hasher_(key)) & (kBucketCount - 1);
+    while (slots_[pos] != kEmptySlot && !equal_(entries_[slots_[pos]].first, key)) {
+        pos = (pos + 1) & (kBucketCount - 1);
+    }
+    return pos;
+}
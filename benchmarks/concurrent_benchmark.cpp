@@ -0,0 +1,123 @@
+// Mixed read/write throughput of ConcurrentHashMap against a HashMap behind one global mutex.
+//
+//     g++ -std=c++17 -O2 -pthread -I. benchmarks/concurrent_benchmark.cpp -o concurrent_benchmark
+//     ./concurrent_benchmark [max_threads] [read_percent]
+//
+// Every thread runs the same number of operations on uniformly random keys of a prefilled
+// table; read_percent of them are lookups, the rest are split evenly between upserts and
+// erases, so the table size stays roughly constant.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ConcurrentHashMap.h"
+
+namespace {
+
+constexpr uint64_t kKeyRange = 1 << 22;
+constexpr size_t kOpsPerThread = 2000000;
+
+// Keeps the lookups from being optimized away.
+std::atomic<size_t> g_found{0};
+
+class GlobalLockMap {
+public:
+    bool find(uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return map_.contains(key);
+    }
+
+    void upsert(uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++map_[key];
+    }
+
+    void erase(uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        map_.erase(key);
+    }
+
+private:
+    std::mutex mutex_;
+    HashMap<uint64_t, uint64_t> map_;
+};
+
+class ShardedMap {
+public:
+    bool find(uint64_t key) {
+        return map_.find(key, [](uint64_t) {});
+    }
+
+    void upsert(uint64_t key) {
+        map_.upsert(key, [](uint64_t& value) { ++value; }, 1);
+    }
+
+    void erase(uint64_t key) {
+        map_.erase(key);
+    }
+
+private:
+    ConcurrentHashMap<uint64_t, uint64_t> map_;
+};
+
+// Returns millions of operations per second over all threads.
+template <class Map>
+double Run(Map& map, unsigned threads, unsigned read_percent) {
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&map, t, read_percent] {
+            std::mt19937_64 rng(t + 1);
+            size_t found = 0;
+            for (size_t i = 0; i < kOpsPerThread; ++i) {
+                uint64_t r = rng();
+                uint64_t key = r % kKeyRange;
+                unsigned op = static_cast<unsigned>((r >> 40) % 100);
+                if (op < read_percent) {
+                    found += map.find(key);
+                } else if (op % 2 == 0) {
+                    map.upsert(key);
+                } else {
+                    map.erase(key);
+                }
+            }
+            g_found += found;
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return threads * kOpsPerThread / elapsed.count() / 1e6;
+}
+
+template <class Map>
+double Measure(unsigned threads, unsigned read_percent) {
+    Map map;
+    for (uint64_t key = 0; key < kKeyRange; key += 2) {
+        map.upsert(key);
+    }
+    return Run(map, threads, read_percent);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    unsigned max_threads = argc > 1 ? std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    unsigned read_percent = argc > 2 ? std::atoi(argv[2]) : 90;
+    std::printf("%d%% reads, %zu ops per thread, Mops/s\n", read_percent, kOpsPerThread);
+    std::printf("%8s %12s %12s\n", "threads", "global_lock", "sharded");
+    for (unsigned threads = 1; threads <= std::max(max_threads, 1u); threads *= 2) {
+        double global = Measure<GlobalLockMap>(threads, read_percent);
+        double sharded = Measure<ShardedMap>(threads, read_percent);
+        std::printf("%8u %12.2f %12.2f\n", threads, global, sharded);
+    }
+    return 0;
+}
@@ -0,0 +1,324 @@
+// HashMap against std::unordered_map on insert, lookups, erase churn, bulk erase, iteration, copy
+// and rehash, for integer and string keys; FrozenHashMap on lookups and iteration; and the
+// throughput of HashBytes, the string hash of FastHash, from 8 bytes to 64K.
+//
+//     ./hashmap_benchmark [--max_size=N] [Google Benchmark flags]
+//
+// Sizes go from 1K up to --max_size (default 1M, at most 100M) in steps of 8x. Results are
+// written as JSON with --benchmark_out=results.json --benchmark_out_format=json, which is what
+// the benchmark_json build target does.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FrozenHashMap.h"
+#include "HashMap.h"
+
+namespace {
+
+uint64_t SplitMix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// The i-th key of a sequence; different seeds give disjoint sequences in practice.
+template <class Key>
+Key MakeKey(uint64_t i, uint64_t seed);
+
+template <>
+uint64_t MakeKey<uint64_t>(uint64_t i, uint64_t seed) {
+    return SplitMix(i ^ (seed << 56));
+}
+
+template <>
+std::string MakeKey<std::string>(uint64_t i, uint64_t seed) {
+    // 20 characters, so the string does not fit the small-string buffer.
+    char buffer[24];
+    std::snprintf(buffer, sizeof(buffer), "key:%016llx", static_cast<unsigned long long>(MakeKey<uint64_t>(i, seed)));
+    return buffer;
+}
+
+template <class Key>
+std::vector<Key> MakeKeys(size_t count, uint64_t seed) {
+    std::vector<Key> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back(MakeKey<Key>(i, seed));
+    }
+    return keys;
+}
+
+template <class Map>
+constexpr bool kIsFrozen = false;
+
+template <class Key, class Value>
+constexpr bool kIsFrozen<FrozenHashMap<Key, Value>> = true;
+
+template <class Map, class Key>
+Map MakeMap(const std::vector<Key>& keys) {
+    if constexpr (kIsFrozen<Map>) {
+        // A FrozenHashMap is built from a complete HashMap in one go.
+        return Map(MakeMap<HashMap<Key, uint64_t>>(keys));
+    } else {
+        Map map;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            map.insert({keys[i], i});
+        }
+        return map;
+    }
+}
+
+template <class Map, class Key>
+void BM_Insert(benchmark::State& state) {
+    std::vector<Key> keys = MakeKeys<Key>(state.range(0), 1);
+    for (auto _ : state) {
+        Map map;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            map.insert({keys[i], i});
+        }
+        benchmark::DoNotOptimize(map);
+        state.PauseTiming();
+        map = Map();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <class Map, class Key>
+void BM_FindHit(benchmark::State& state) {
+    std::vector<Key> keys = MakeKeys<Key>(state.range(0), 1);
+    Map map = MakeMap<Map>(keys);
+    // Looked up in a different order than inserted, so consecutive lookups are unrelated.
+    std::vector<Key> lookups = keys;
+    for (size_t i = lookups.size(); i > 1; --i) {
+        std::swap(lookups[i - 1], lookups[SplitMix(i) % i]);
+    }
+    for (auto _ : state) {
+        for (const Key& key : lookups) {
+            benchmark::DoNotOptimize(map.find(key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * lookups.size());
+}
+
+template <class Map, class Key>
+void BM_FindMiss(benchmark::State& state) {
+    Map map = MakeMap<Map>(MakeKeys<Key>(state.range(0), 1));
+    std::vector<Key> lookups = MakeKeys<Key>(state.range(0), 2);
+    for (auto _ : state) {
+        for (const Key& key : lookups) {
+            benchmark::DoNotOptimize(map.find(key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * lookups.size());
+}
+
+// Every step erases a present key and inserts a new one, so the size stays constant.
+template <class Map, class Key>
+void BM_EraseChurn(benchmark::State& state) {
+    std::vector<Key> present = MakeKeys<Key>(state.range(0), 1);
+    std::vector<Key> absent = MakeKeys<Key>(state.range(0), 2);
+    Map map = MakeMap<Map>(present);
+    for (auto _ : state) {
+        for (size_t i = 0; i < present.size(); ++i) {
+            map.erase(present[i]);
+            map.insert({absent[i], i});
+        }
+        std::swap(present, absent);
+    }
+    state.SetItemsProcessed(state.iterations() * present.size() * 2);
+}
+
+// Removes the elements with an odd value, i.e. every other one.
+template <class Map>
+size_t EraseOdd(Map& map) {
+    return map.erase_if([](const auto& element) { return element.second % 2 == 1; });
+}
+
+template <class Key>
+size_t EraseOdd(std::unordered_map<Key, uint64_t>& map) {
+    size_t erased = 0;
+    for (auto it = map.begin(); it != map.end();) {
+        if (it->second % 2 == 1) {
+            it = map.erase(it);
+            ++erased;
+        } else {
+            ++it;
+        }
+    }
+    return erased;
+}
+
+// Erases half of the map in one call; restoring the full map is not timed.
+template <class Map, class Key>
+void BM_EraseIf(benchmark::State& state) {
+    Map full = MakeMap<Map>(MakeKeys<Key>(state.range(0), 1));
+    for (auto _ : state) {
+        state.PauseTiming();
+        Map map(full);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(EraseOdd(map));
+        state.PauseTiming();
+        map = Map();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * full.size());
+}
+
+template <class Map, class Key>
+void BM_Iterate(benchmark::State& state) {
+    Map map = MakeMap<Map>(MakeKeys<Key>(state.range(0), 1));
+    for (auto _ : state) {
+        uint64_t sum = 0;
+        for (const auto& element : map) {
+            sum += element.second;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * map.size());
+}
+
+template <class Map, class Key>
+void BM_Copy(benchmark::State& state) {
+    Map map = MakeMap<Map>(MakeKeys<Key>(state.range(0), 1));
+    for (auto _ : state) {
+        Map copy(map);
+        benchmark::DoNotOptimize(copy);
+        state.PauseTiming();
+        copy = Map();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * map.size());
+}
+
+// Doubles the bucket count; shrinking back is not timed.
+template <class Map, class Key>
+void BM_Rehash(benchmark::State& state) {
+    Map map = MakeMap<Map>(MakeKeys<Key>(state.range(0), 1));
+    for (auto _ : state) {
+        map.rehash(map.bucket_count() * 2);
+        state.PauseTiming();
+        map.rehash(0);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * map.size());
+}
+
+// Each iteration hashes the next 8-byte aligned window of a buffer, so the input is not constant.
+void BM_HashBytes(benchmark::State& state) {
+    size_t size = static_cast<size_t>(state.range(0));
+    std::vector<unsigned char> buffer(size + 4096);
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = static_cast<unsigned char>(SplitMix(i));
+    }
+    uint64_t hash = 0;
+    size_t offset = 0;
+    for (auto _ : state) {
+        hash = HashBytes(buffer.data() + offset, size, hash);
+        offset = (offset + 8) % 4096;
+    }
+    benchmark::DoNotOptimize(hash);
+    state.SetBytesProcessed(state.iterations() * size);
+}
+
+// Runs Function, reporting an exception thrown while the map is built (e.g. a FrozenHashMap
+// build giving up) as an error of this benchmark instead of aborting the whole run.
+template <void (*Function)(benchmark::State&)>
+void SkipOnError(benchmark::State& state) {
+    try {
+        Function(state);
+    } catch (const std::exception& error) {
+        state.SkipWithError(error.what());
+    }
+}
+
+template <class Map, class Key>
+void RegisterAll(const std::string& map_name, const std::string& key_name, int64_t max_size) {
+    struct Case {
+        const char* name;
+        void (*function)(benchmark::State&);
+    };
+    const Case cases[] = {
+        {"Insert", &BM_Insert<Map, Key>},
+        {"FindHit", &BM_FindHit<Map, Key>},
+        {"FindMiss", &BM_FindMiss<Map, Key>},
+        {"EraseChurn", &BM_EraseChurn<Map, Key>},
+        {"EraseIf", &BM_EraseIf<Map, Key>},
+        {"Iterate", &BM_Iterate<Map, Key>},
+        {"Copy", &BM_Copy<Map, Key>},
+        {"Rehash", &BM_Rehash<Map, Key>},
+    };
+    for (const Case& c : cases) {
+        std::string name = std::string(c.name) + "<" + map_name + ", " + key_name + ">";
+        benchmark::RegisterBenchmark(name.c_str(), c.function)->RangeMultiplier(8)->Range(1 << 10, max_size);
+    }
+}
+
+// FrozenHashMap cannot be modified, so only the read-only cases apply.
+template <class Key>
+void RegisterFrozen(const std::string& key_name, int64_t max_size) {
+    using Map = FrozenHashMap<Key, uint64_t>;
+    struct Case {
+        const char* name;
+        void (*function)(benchmark::State&);
+    };
+    const Case cases[] = {
+        {"FindHit", &SkipOnError<&BM_FindHit<Map, Key>>},
+        {"FindMiss", &SkipOnError<&BM_FindMiss<Map, Key>>},
+        {"Iterate", &SkipOnError<&BM_Iterate<Map, Key>>},
+    };
+    for (const Case& c : cases) {
+        std::string name = std::string(c.name) + "<FrozenHashMap, " + key_name + ">";
+        benchmark::RegisterBenchmark(name.c_str(), c.function)->RangeMultiplier(8)->Range(1 << 10, max_size);
+    }
+}
+
+template <class Key>
+void RegisterMaps(const std::string& key_name, int64_t max_size) {
+    RegisterAll<HashMap<Key, uint64_t>, Key>("HashMap", key_name, max_size);
+    RegisterAll<HashMap<Key, uint64_t, std::hash<Key>, std::equal_to<Key>, GroupProbing>, Key>("HashMap<Group>",
+                                                                                              key_name, max_size);
+    RegisterAll<HashMap<Key, uint64_t, FastHash<Key>>, Key>("HashMap<FastHash>", key_name, max_size);
+    RegisterAll<std::unordered_map<Key, uint64_t>, Key>("unordered_map", key_name, max_size);
+    RegisterFrozen<Key>(key_name, max_size);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int64_t max_size = 1 << 20;
+    const char kMaxSizeFlag[] = "--max_size=";
+    // Consume --max_size before Google Benchmark rejects it as unknown.
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], kMaxSizeFlag, sizeof(kMaxSizeFlag) - 1) == 0) {
+            max_size = std::min<int64_t>(std::atoll(argv[i] + sizeof(kMaxSizeFlag) - 1), 100000000);
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+
+    RegisterMaps<uint64_t>("uint64", max_size);
+    RegisterMaps<std::string>("string", max_size);
+    benchmark::RegisterBenchmark("HashBytes", &BM_HashBytes)->RangeMultiplier(8)->Range(8, 1 << 16);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,1154 @@
+// Tests of the maps in this library, run by CTest as hashmap_tests:
+//
+//     cmake -S . -B build && cmake --build build && ctest --test-dir build --output-on-failure
+//
+// CTest also runs them as hashmap_stats_tests, built from this file with HASHMAP_ENABLE_STATS,
+// which adds the tests of HashMap::stats().
+//
+// Every test is a function in kTests. A failed CHECK prints its location and expression and
+// fails the test; the program runs all tests and exits with a non-zero status if any failed.
+// A single test runs with ./hashmap_tests <name>.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ConcurrentHashMap.h"
+#include "FrozenHashMap.h"
+#include "HashMap.h"
+#include "MappedHashMap.h"
+#include "ReadMostlyHashMap.h"
+#include "StaticHashMap.h"
+
+namespace {
+
+struct CheckFailure : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Variadic, so that conditions may contain commas, e.g. in template argument lists.
+#define CHECK(...)                                                                                      \
+    do {                                                                                                \
+        if (!(__VA_ARGS__)) {                                                                           \
+            throw CheckFailure(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #__VA_ARGS__); \
+        }                                                                                               \
+    } while (false)
+
+template <class Exception, class F>
+bool Throws(F&& f) {
+    try {
+        f();
+    } catch (const Exception&) {
+        return true;
+    }
+    return false;
+}
+
+// Checks map against the reference contents: size, iteration and a lookup of every key.
+template <class Map, class Key, class Value>
+void CheckSame(const Map& map, const std::unordered_map<Key, Value>& expected) {
+    CHECK(map.size() == expected.size());
+    CHECK(map.empty() == expected.empty());
+    size_t iterated = 0;
+    for (const auto& element : map) {
+        auto it = expected.find(element.first);
+        CHECK(it != expected.end());
+        CHECK(it->second == element.second);
+        ++iterated;
+    }
+    CHECK(iterated == expected.size());
+    for (const auto& element : expected) {
+        auto it = map.find(element.first);
+        CHECK(it != map.end());
+        CHECK(it->second == element.second);
+    }
+}
+
+// A batch size below, equal to or above HashMap's prefetch distance of 16 keys, so that batches
+// both shorter and longer than the prefetch window are checked.
+size_t RandomBatchSize(std::mt19937_64& random) {
+    constexpr size_t kPrefetchDistance = 16;
+    switch (random() % 3) {
+        case 0:
+            return random() % kPrefetchDistance;
+        case 1:
+            return kPrefetchDistance;
+        default:
+            return kPrefetchDistance + 1 + random() % (3 * kPrefetchDistance);
+    }
+}
+
+// A random mix of every modifying operation, applied to a HashMap and to std::unordered_map
+// alike. Keys come from a range about twice the live size, so inserts and erases both hit and
+// miss, and the map grows through several rehashes.
+template <class ProbingPolicy, class GrowthPolicy>
+void RunDifferential(bool incremental, float max_load_factor, uint64_t seed) {
+    using Map = HashMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, ProbingPolicy, GrowthPolicy>;
+    constexpr size_t kOps = 40000;
+    constexpr uint64_t kKeyRange = 6000;
+
+    std::mt19937_64 random(seed);
+    Map map;
+    map.max_load_factor(max_load_factor);
+    map.incremental_rehash(incremental);
+    std::unordered_map<uint64_t, uint64_t> expected;
+
+    for (size_t i = 0; i < kOps; ++i) {
+        uint64_t key = random() % kKeyRange;
+        uint64_t value = random();
+        switch (random() % 18) {
+            case 0:
+            case 1:
+            case 2: {
+                auto result = map.insert({key, value});
+                auto reference = expected.insert({key, value});
+                CHECK(result.second == reference.second);
+                CHECK(result.first->first == key && result.first->second == reference.first->second);
+                break;
+            }
+            case 3: {
+                auto result = map.emplace(key, value);
+                CHECK(result.second == expected.emplace(key, value).second);
+                break;
+            }
+            case 4:
+                CHECK(map.try_emplace(key, value).second == expected.try_emplace(key, value).second);
+                break;
+            case 5:
+                CHECK(map.insert_or_assign(key, value).second == expected.insert_or_assign(key, value).second);
+                break;
+            case 6:
+                map[key] += value;
+                expected[key] += value;
+                break;
+            case 7:
+            case 8:
+            case 9:
+            case 10:
+                CHECK(map.erase(key) == expected.erase(key));
+                break;
+            case 11:
+            case 12: {
+                auto it = map.find(key);
+                auto reference = expected.find(key);
+                CHECK((it == map.end()) == (reference == expected.end()));
+                if (it != map.end()) {
+                    CHECK(it->second == reference->second);
+                }
+                CHECK(map.count(key) == expected.count(key));
+                break;
+            }
+            case 13: {
+                // Every slot array is swept while a migration may still be pending.
+                uint64_t mask = random() % 8;
+                size_t erased = map.erase_if([mask](const auto& element) { return element.first % 8 == mask; });
+                size_t reference = 0;
+                for (auto it = expected.begin(); it != expected.end();) {
+                    if (it->first % 8 == mask) {
+                        it = expected.erase(it);
+                        ++reference;
+                    } else {
+                        ++it;
+                    }
+                }
+                CHECK(erased == reference);
+                break;
+            }
+            case 14: {
+                std::vector<std::pair<uint64_t, uint64_t>> batch;
+                for (size_t j = 0; j < 32; ++j) {
+                    batch.emplace_back(random() % kKeyRange, random());
+                }
+                map.insert(batch.begin(), batch.end());
+                for (const auto& element : batch) {
+                    expected.insert(element);
+                }
+                break;
+            }
+            case 15: {
+                std::vector<uint64_t> keys(RandomBatchSize(random));
+                for (uint64_t& batch_key : keys) {
+                    batch_key = random() % kKeyRange;
+                }
+                std::vector<typename Map::iterator> found(keys.size());
+                map.find_batch(keys.begin(), keys.end(), found.begin());
+                std::vector<typename Map::const_iterator> found_const(keys.size());
+                std::as_const(map).find_batch(keys.begin(), keys.end(), found_const.begin());
+                std::vector<bool> contained(keys.size());
+                map.contains_batch(keys.begin(), keys.end(), contained.begin());
+                for (size_t j = 0; j < keys.size(); ++j) {
+                    CHECK(found[j] == map.find(keys[j]));
+                    CHECK(found_const[j] == std::as_const(map).find(keys[j]));
+                    CHECK(contained[j] == map.contains(keys[j]));
+                    CHECK(contained[j] == (expected.count(keys[j]) == 1));
+                }
+                break;
+            }
+            case 16: {
+                // Repeated keys within a batch keep the first value, as with insert.
+                std::vector<std::pair<uint64_t, uint64_t>> batch(RandomBatchSize(random));
+                for (auto& element : batch) {
+                    element = {random() % kKeyRange, random()};
+                }
+                size_t inserted = map.insert_batch(batch.begin(), batch.end());
+                size_t reference = 0;
+                for (const auto& element : batch) {
+                    reference += expected.insert(element).second;
+                }
+                CHECK(inserted == reference);
+                for (const auto& element : batch) {
+                    auto it = map.find(element.first);
+                    CHECK(it != map.end() && it->second == expected.at(element.first));
+                }
+                break;
+            }
+            default:
+                switch (random() % 64) {
+                    case 0:
+                        map.clear();
+                        expected.clear();
+                        break;
+                    case 1:
+                        map.rehash(random() % (2 * map.size() + 1));
+                        break;
+                    case 2:
+                        map.reserve(map.size() + random() % 1000);
+                        break;
+                    case 3:
+                        map.shrink_to_fit();
+                        break;
+                    case 4: {
+                        Map copy(map);
+                        CheckSame(copy, expected);
+                        map = std::move(copy);
+                        break;
+                    }
+                    case 5: {
+                        Map other;
+                        other.swap(map);
+                        map = other;
+                        break;
+                    }
+                    default:
+                        break;
+                }
+                break;
+        }
+        if (i % 4096 == 0) {
+            CheckSame(map, expected);
+        }
+    }
+    CheckSame(map, expected);
+    CHECK(map.load_factor() <= map.max_load_factor());
+
+    std::vector<uint64_t> keys;
+    for (uint64_t key = 0; key < kKeyRange; ++key) {
+        keys.push_back(key);
+    }
+    std::vector<bool> found(keys.size());
+    map.contains_batch(keys.begin(), keys.end(), found.begin());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        CHECK(found[i] == (expected.count(keys[i]) == 1));
+    }
+}
+
+template <class ProbingPolicy, class GrowthPolicy>
+void RunDifferentialConfigurations() {
+    uint64_t seed = 1;
+    for (bool incremental : {false, true}) {
+        for (float max_load_factor : {0.25f, 0.5f, 0.75f, 0.9f, 0.97f}) {
+            RunDifferential<ProbingPolicy, GrowthPolicy>(incremental, max_load_factor, seed++);
+        }
+    }
+}
+
+void TestDifferentialLinear() {
+    RunDifferentialConfigurations<LinearProbing, PowerOfTwoGrowthPolicy>();
+    RunDifferentialConfigurations<LinearProbing, FastRangeGrowthPolicy>();
+    RunDifferentialConfigurations<LinearProbing, PrimeGrowthPolicy>();
+}
+
+void TestDifferentialGroup() {
+    RunDifferentialConfigurations<GroupProbing, PowerOfTwoGrowthPolicy>();
+    RunDifferentialConfigurations<GroupProbing, FastRangeGrowthPolicy>();
+    RunDifferentialConfigurations<GroupProbing, PrimeGrowthPolicy>();
+}
+
+// Keys that all share a handful of hash values form long clusters, which exercises the Robin
+// Hood displacement and backward shifting far more than a good hash does.
+struct ClusteringHash {
+    size_t operator()(const std::string& key) const {
+        return std::hash<std::string>()(key) % 7;
+    }
+};
+
+void TestStringKeysWithCollisions() {
+    HashMap<std::string, int, ClusteringHash, std::equal_to<std::string>, GroupProbing> map;
+    map.max_load_factor(0.9f);
+    std::unordered_map<std::string, int> expected;
+    std::mt19937_64 random(7);
+    for (int i = 0; i < 3000; ++i) {
+        std::string key = "key" + std::to_string(random() % 700);
+        if (random() % 3 == 0) {
+            CHECK(map.erase(key) == expected.erase(key));
+        } else {
+            map[key] = i;
+            expected[key] = i;
+        }
+    }
+    CheckSame(map, expected);
+}
+
+// Detects whether map.find(key) compiles, which for a std::string map and a std::string_view key
+// (not implicitly convertible to std::string) means a transparent overload exists.
+template <class Map, class K, class = void>
+struct HasFind : std::false_type {};
+
+template <class Map, class K>
+struct HasFind<Map, K, std::void_t<decltype(std::declval<Map&>().find(std::declval<const K&>()))>>
+    : std::true_type {};
+
+using TransparentStringMap = HashMap<std::string, int, FastHash<std::string>, std::equal_to<>>;
+static_assert(HasFind<TransparentStringMap, std::string_view>::value);
+// Both Hash and Equal must be transparent.
+static_assert(!HasFind<HashMap<std::string, int, std::hash<std::string>, std::equal_to<>>, std::string_view>::value);
+static_assert(!HasFind<HashMap<std::string, int, FastHash<std::string>>, std::string_view>::value);
+
+template <class ProbingPolicy>
+void RunTransparentLookup(bool incremental) {
+    HashMap<std::string, int, FastHash<std::string>, std::equal_to<>, ProbingPolicy> map;
+    map.incremental_rehash(incremental);
+    for (int i = 0; i < 5000; ++i) {
+        map.insert({"key" + std::to_string(i), i});
+    }
+    for (int i = 0; i < 5000; ++i) {
+        std::string key = "key" + std::to_string(i);
+        std::string_view view = key;
+        CHECK(map.find(view) != map.end() && map.find(view)->second == i);
+        CHECK(map.find(view) == map.find(key));
+        CHECK(map.contains(view) && map.count(view) == 1);
+    }
+    std::string_view absent = "absent";
+    CHECK(map.find(absent) == map.end() && !map.contains(absent) && map.count(absent) == 0);
+    CHECK(map.contains("key7"));
+
+    for (int i = 0; i < 5000; i += 2) {
+        std::string key = "key" + std::to_string(i);
+        CHECK(map.erase(std::string_view(key)) == 1);
+        CHECK(map.erase(std::string_view(key)) == 0);
+    }
+    CHECK(map.size() == 2500);
+    for (int i = 0; i < 5000; ++i) {
+        std::string key = "key" + std::to_string(i);
+        CHECK(map.contains(std::string_view(key)) == (i % 2 == 1));
+    }
+}
+
+void TestTransparentLookup() {
+    for (bool incremental : {false, true}) {
+        RunTransparentLookup<LinearProbing>(incremental);
+        RunTransparentLookup<GroupProbing>(incremental);
+    }
+}
+
+static_assert(std::is_nothrow_move_constructible_v<HashMap<int, int>>);
+static_assert(std::is_nothrow_move_assignable_v<HashMap<int, int>>);
+static_assert(std::is_nothrow_move_constructible_v<HashMap<std::string, std::string, FastHash<std::string>>>);
+static_assert(std::is_nothrow_move_assignable_v<HashMap<std::string, int, std::hash<std::string>,
+                                                        std::equal_to<std::string>, GroupProbing>>);
+// A polymorphic allocator does not propagate, so move assignment may have to copy elements.
+static_assert(!std::is_nothrow_move_assignable_v<pmr::HashMap<int, int>>);
+
+// Default-constructed and moved-from maps own no memory and behave as empty maps.
+template <class ProbingPolicy>
+void RunMovedFrom() {
+    using Map = HashMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, ProbingPolicy>;
+    Map map;
+    CHECK(map.memory_usage().total() == 0);
+    CHECK(map.find(1) == map.end());
+    CHECK(map.erase(1) == 0);
+    CHECK(map.load_factor() == 0.0f);
+
+    for (uint64_t key = 0; key < 1000; ++key) {
+        map.insert({key, key});
+    }
+    Map moved(std::move(map));
+    CHECK(moved.size() == 1000);
+    CHECK(map.memory_usage().total() == 0);
+    CHECK(map.empty() && map.begin() == map.end());
+    for (uint64_t key = 0; key < 1000; ++key) {
+        CHECK(!map.contains(key));
+    }
+    std::vector<uint64_t> keys = {1, 2, 3};
+    std::vector<bool> found(keys.size(), true);
+    map.contains_batch(keys.begin(), keys.end(), found.begin());
+    CHECK(std::none_of(found.begin(), found.end(), [](bool f) { return f; }));
+
+    Map assigned;
+    assigned.incremental_rehash(true);
+    for (uint64_t key = 0; key < 5000; ++key) {
+        assigned.insert({key, key});
+    }
+    assigned = std::move(moved);
+    CHECK(assigned.size() == 1000 && assigned.at(999) == 999);
+    CHECK(moved.memory_usage().total() == 0);
+
+    // Both are usable again.
+    std::vector<std::pair<uint64_t, uint64_t>> batch = {{5, 50}, {6, 60}, {5, 70}};
+    CHECK(map.insert_batch(batch.begin(), batch.end()) == 2);
+    CHECK(map.at(5) == 50 && map.at(6) == 60);
+    moved[7] = 8;
+    CHECK(moved.size() == 1 && moved.at(7) == 8);
+    moved.erase(7);
+    CHECK(moved.empty());
+
+    const std::string path = "hashmap_tests_empty.bin";
+    Map().save(path);
+    CHECK(MappedHashMap<uint64_t, uint64_t, std::hash<uint64_t>>(path).empty());
+    std::remove(path.c_str());
+}
+
+// Between maps on different memory resources the elements are moved one by one.
+template <class Map>
+void RunMoveAcrossResources() {
+    std::pmr::monotonic_buffer_resource first;
+    std::pmr::monotonic_buffer_resource second;
+    Map source(&first);
+    for (uint64_t key = 0; key < 20000; ++key) {
+        source[key] = std::to_string(key);
+    }
+    Map target(&second);
+    target[1] = "one";
+    target = std::move(source);
+    CHECK(target.get_allocator().resource() == &second);
+    CHECK(target.size() == 20000 && target.at(1) == "1" && target.at(19999) == "19999");
+    CHECK(source.empty() && source.memory_usage().total() == 0);
+}
+
+void TestMovedFrom() {
+    RunMovedFrom<LinearProbing>();
+    RunMovedFrom<GroupProbing>();
+
+    RunMoveAcrossResources<pmr::HashMap<uint64_t, std::string>>();
+    RunMoveAcrossResources<
+        pmr::HashMap<uint64_t, std::string, std::hash<uint64_t>, std::equal_to<uint64_t>, LinearProbing,
+                     PowerOfTwoGrowthPolicy, ChunkedStorage>>();
+}
+
+// Bytes of a bucket array of bucket_count slots: 8-byte slots plus, for GroupProbing, one
+// control byte per slot and the group width less one mirrored past the end.
+template <class ProbingPolicy>
+size_t BucketArrayBytes(size_t bucket_count) {
+    if constexpr (ProbingPolicy::kUseControlBytes) {
+        return bucket_count * 9 + ProbingPolicy::kGroupWidth - 1;
+    } else {
+        return bucket_count * 8;
+    }
+}
+
+template <class ProbingPolicy>
+void RunMemoryUsage() {
+    using Map = HashMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, ProbingPolicy>;
+    constexpr size_t kNodeBytes = sizeof(std::pair<const uint64_t, uint64_t>);
+    auto check_components = [](const Map& map) {
+        auto usage = map.memory_usage();
+        CHECK(usage.total() == usage.hash_map + usage.rehash + usage.data);
+        CHECK(usage.hash_map == BucketArrayBytes<ProbingPolicy>(map.bucket_count()));
+        return usage;
+    };
+
+    Map map;
+    map.reserve(1000);
+    auto usage = check_components(map);
+    CHECK(usage.rehash == 0 && usage.data == 1000 * kNodeBytes);
+    size_t bucket_count = map.bucket_count();
+    for (uint64_t key = 0; key < 1000; ++key) {
+        map.insert({key, key});
+    }
+    CHECK(map.bucket_count() == bucket_count);
+    CHECK(check_components(map).data == 1000 * kNodeBytes);
+
+    map.rehash(4 * bucket_count);
+    CHECK(map.bucket_count() >= 4 * bucket_count);
+    usage = check_components(map);
+    CHECK(usage.rehash == 0 && usage.data == 1000 * kNodeBytes);
+
+    map.erase_if([](const auto& element) { return element.first % 2 == 0; });
+    map.shrink_to_fit();
+    CHECK(map.bucket_count() < 4 * bucket_count);
+    usage = check_components(map);
+    CHECK(usage.rehash == 0 && usage.data == map.size() * kNodeBytes);
+
+    // In incremental mode, rehash holds the next bucket array while it is prepared, then the
+    // old one while it is drained (or both, if a preparation overlaps the end of a migration).
+    Map incremental;
+    incremental.incremental_rehash(true);
+    bool preparing = false;
+    bool draining = false;
+    for (uint64_t key = 0; key < 200000; ++key) {
+        incremental.insert({key, key});
+        usage = check_components(incremental);
+        size_t next = BucketArrayBytes<ProbingPolicy>(2 * incremental.bucket_count());
+        size_t old = incremental.bucket_count() > 2 ? BucketArrayBytes<ProbingPolicy>(incremental.bucket_count() / 2)
+                                                    : 0;
+        CHECK(usage.rehash == 0 || usage.rehash == next || usage.rehash == old || usage.rehash == old + next);
+        preparing |= usage.rehash == next;
+        draining |= usage.rehash == old;
+    }
+    CHECK(preparing && draining);
+}
+
+void TestMemoryUsage() {
+    RunMemoryUsage<LinearProbing>();
+    RunMemoryUsage<GroupProbing>();
+}
+
+template <class Map>
+void RunIncrementalMigration() {
+    Map map;
+    map.incremental_rehash(true);
+    std::unordered_map<uint64_t, uint64_t> expected;
+    // Lookups and erases are checked after every insert, so every state of the migration, with
+    // keys split between both slot arrays, is covered.
+    for (uint64_t key = 0; key < 20000; ++key) {
+        map.insert({key, key * 3});
+        expected.insert({key, key * 3});
+        if (key % 5 == 0) {
+            CHECK(map.erase(key / 2) == expected.erase(key / 2));
+        }
+        uint64_t probe = (key * 7919) % (key + 1);
+        CHECK(map.contains(probe) == (expected.count(probe) == 1));
+    }
+    CheckSame(map, expected);
+    map.incremental_rehash(false);
+    CheckSame(map, expected);
+}
+
+void TestIncrementalMigration() {
+    RunIncrementalMigration<HashMap<uint64_t, uint64_t>>();
+    RunIncrementalMigration<HashMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, GroupProbing,
+                                    PowerOfTwoGrowthPolicy, std::allocator<std::pair<const uint64_t, uint64_t>>,
+                                    ChunkedStorage>>();
+}
+
+// Counts the elements it constructs. Every node a map moves and every slot or tag it
+// initializes goes through construct, so the count bounds the work of a single operation.
+size_t g_constructed = 0;
+
+template <class T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+    template <class U>
+    CountingAllocator(const CountingAllocator<U>&) {
+    }
+
+    T* allocate(size_t count) {
+        return std::allocator<T>().allocate(count);
+    }
+    void deallocate(T* pointer, size_t count) {
+        std::allocator<T>().deallocate(pointer, count);
+    }
+    template <class U, class... Args>
+    void construct(U* pointer, Args&&... args) {
+        ++g_constructed;
+        ::new (static_cast<void*>(pointer)) U(std::forward<Args>(args)...);
+    }
+
+    template <class U>
+    bool operator==(const CountingAllocator<U>&) const {
+        return true;
+    }
+    template <class U>
+    bool operator!=(const CountingAllocator<U>&) const {
+        return false;
+    }
+};
+
+// In incremental mode no insert or erase does work proportional to the size of the map, while
+// a plain map builds the whole new bucket array on the insert that makes it grow.
+// The most elements constructed by a single insert or erase while the map grows to 300000.
+template <class Map>
+size_t MostConstructedPerStep(float max_load_factor, bool incremental) {
+    Map map;
+    map.max_load_factor(max_load_factor);
+    map.incremental_rehash(incremental);
+    std::unordered_map<uint64_t, uint64_t> expected;
+    size_t most = 0;
+    for (uint64_t key = 0; key < 300000; ++key) {
+        size_t before = g_constructed;
+        map.insert({key, key});
+        expected.insert({key, key});
+        if (key % 7 == 0) {
+            map.erase(key / 2);
+            expected.erase(key / 2);
+        }
+        most = std::max(most, g_constructed - before);
+    }
+    CheckSame(map, expected);
+    return most;
+}
+
+template <class ProbingPolicy>
+void RunIncrementalBoundedWork(float max_load_factor) {
+    using Allocator = CountingAllocator<std::pair<const uint64_t, uint64_t>>;
+    using Contiguous = HashMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, ProbingPolicy,
+                               PowerOfTwoGrowthPolicy, Allocator>;
+    using Chunked = HashMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, ProbingPolicy,
+                            PowerOfTwoGrowthPolicy, Allocator, ChunkedStorage>;
+    CHECK(MostConstructedPerStep<Contiguous>(max_load_factor, false) > 100000);
+    CHECK(MostConstructedPerStep<Chunked>(max_load_factor, false) > 100000);
+    CHECK(MostConstructedPerStep<Chunked>(max_load_factor, true) < 10000);
+}
+
+void TestIncrementalBoundedWork() {
+    for (float max_load_factor : {0.25f, 0.9f}) {
+        RunIncrementalBoundedWork<LinearProbing>(max_load_factor);
+        RunIncrementalBoundedWork<GroupProbing>(max_load_factor);
+    }
+}
+
+void TestEraseIf() {
+    HashMap<uint64_t, uint64_t> map;
+    map.max_load_factor(0.9f);
+    std::unordered_map<uint64_t, uint64_t> expected;
+    for (uint64_t key = 0; key < 50000; ++key) {
+        map.insert({key * 977, key});
+        expected.insert({key * 977, key});
+    }
+    CHECK(map.erase_if([](const auto& element) { return element.second % 3 != 0; }) == 33333);
+    for (auto it = expected.begin(); it != expected.end();) {
+        it = it->second % 3 != 0 ? expected.erase(it) : std::next(it);
+    }
+    CheckSame(map, expected);
+
+    // A throwing predicate leaves the map unchanged.
+    size_t calls = 0;
+    CHECK(Throws<std::runtime_error>([&map, &calls] {
+        map.erase_if([&calls](const auto&) -> bool {
+            if (++calls == 1000) {
+                throw std::runtime_error("stop");
+            }
+            return true;
+        });
+    }));
+    CheckSame(map, expected);
+
+    CHECK(map.erase_if([](const auto&) { return true; }) == expected.size());
+    CHECK(map.empty());
+    CHECK(map.find(0) == map.end());
+}
+
+void TestParallel() {
+    HashMap<uint64_t, uint64_t> map;
+    uint64_t sum = 0;
+    for (uint64_t key = 0; key < 100000; ++key) {
+        map.insert({key, key});
+        sum += key;
+    }
+    map.parallel_for_each([](auto& element) { element.second *= 2; }, 4);
+    CHECK(map.parallel_reduce(
+              uint64_t(0), std::plus<uint64_t>(), [](const auto& element) { return element.second; }, 4) == 2 * sum);
+    CHECK(Throws<std::logic_error>([&map] {
+        map.parallel_for_each([](const auto& element) {
+            if (element.first == 77777) {
+                throw std::logic_error("fn");
+            }
+        });
+    }));
+}
+
+void TestMappedRoundTrip() {
+    const std::string path = "hashmap_tests_image.bin";
+
+    HashMap<uint64_t, uint64_t> numbers;
+    numbers.incremental_rehash(true);
+    for (uint64_t key = 0; key < 30000; ++key) {
+        numbers.insert({key * 31, key});
+    }
+    // Saving in the middle of a migration finishes it on a copy.
+    numbers.save(path);
+    {
+        MappedHashMap<uint64_t, uint64_t> mapped(path);
+        CHECK(mapped.size() == numbers.size());
+        for (const auto& element : numbers) {
+            CHECK(mapped.at(element.first) == element.second);
+        }
+        CHECK(!mapped.contains(1));
+        size_t iterated = 0;
+        for (auto it = mapped.begin(); it != mapped.end(); ++it) {
+            CHECK(numbers.at((*it).first) == (*it).second);
+            ++iterated;
+        }
+        CHECK(iterated == numbers.size());
+    }
+
+    // Saving over an image that is still mapped replaces the file instead of rewriting it, so
+    // the open map keeps serving the old contents.
+    {
+        MappedHashMap<uint64_t, uint64_t> before(path);
+        HashMap<uint64_t, uint64_t> replacement;
+        for (uint64_t key = 0; key < 1000; ++key) {
+            replacement.insert({key, key + 1});
+        }
+        replacement.save(path);
+        CHECK(before.size() == numbers.size());
+        for (const auto& element : numbers) {
+            CHECK(before.at(element.first) == element.second);
+        }
+        MappedHashMap<uint64_t, uint64_t> after(path);
+        CHECK(after.size() == 1000 && after.at(999) == 1000 && !after.contains(999 * 31));
+        CHECK(!std::ifstream(path + ".tmp"));
+    }
+
+    HashMap<std::string, std::string, std::hash<std::string>, std::equal_to<std::string>, GroupProbing> strings;
+    for (int i = 0; i < 5000; ++i) {
+        strings.insert({"key" + std::to_string(i), std::string(i % 50, 'x')});
+    }
+    strings.save(path);
+    {
+        MappedHashMap<std::string, std::string, std::hash<std::string>> mapped(path);
+        CHECK(mapped.size() == strings.size());
+        for (const auto& element : strings) {
+            CHECK(mapped.at(element.first) == element.second);
+        }
+        CHECK(mapped.find("absent") == mapped.end());
+    }
+
+    // A map with different parameters refuses the image.
+    CHECK(Throws<std::runtime_error>([&path] { MappedHashMap<uint64_t, uint64_t> mapped(path); }));
+    std::remove(path.c_str());
+}
+
+// Overwrites the 8-byte word at offset of the file at path, returning the word that was there.
+uint64_t PatchWord(const std::string& path, uint64_t offset, uint64_t word) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    uint64_t old = 0;
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(reinterpret_cast<char*>(&old), sizeof(old));
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(reinterpret_cast<const char*>(&word), sizeof(word));
+    return old;
+}
+
+void TestMappedVerify() {
+    const std::string path = "hashmap_tests_verify.bin";
+    const uint64_t kBucketCountOffset = 24;
+    const uint64_t kSlotsOffset = 128;
+    const uint64_t kEntriesOffsetField = 48;
+
+    HashMap<uint64_t, uint64_t> numbers;
+    for (uint64_t key = 0; key < 1000; ++key) {
+        numbers.insert({key, key});
+    }
+    numbers.save(path);
+    MappedHashMap<uint64_t, uint64_t>(path).verify();
+
+    // A bucket count whose slot array size overflows 64 bits is refused on open.
+    uint64_t bucket_count = PatchWord(path, kBucketCountOffset, 1ull << 61);
+    CHECK(Throws<std::runtime_error>([&path] { MappedHashMap<uint64_t, uint64_t> mapped(path); }));
+    PatchWord(path, kBucketCountOffset, bucket_count);
+
+    // A slot pointing past the entries opens, since slots are not read on open, but fails verify().
+    PatchWord(path, kSlotsOffset, 1000000);
+    {
+        MappedHashMap<uint64_t, uint64_t> mapped(path);
+        CHECK(Throws<std::runtime_error>([&mapped] { mapped.verify(); }));
+    }
+
+    HashMap<std::string, std::string, std::hash<std::string>> strings;
+    for (int i = 0; i < 1000; ++i) {
+        strings.insert({"key" + std::to_string(i), "value" + std::to_string(i)});
+    }
+    strings.save(path);
+    MappedHashMap<std::string, std::string, std::hash<std::string>>(path).verify();
+
+    // The first entry's key points far outside the string area.
+    uint64_t entries_offset = PatchWord(path, kEntriesOffsetField, 0);
+    PatchWord(path, kEntriesOffsetField, entries_offset);
+    PatchWord(path, entries_offset, 1ull << 40);
+    {
+        MappedHashMap<std::string, std::string, std::hash<std::string>> mapped(path);
+        CHECK(Throws<std::runtime_error>([&mapped] { mapped.verify(); }));
+    }
+    std::remove(path.c_str());
+}
+
+void TestFrozen() {
+    HashMap<uint64_t, uint64_t> source;
+    for (uint64_t key = 0; key < 200000; ++key) {
+        source.insert({key * 0x9E3779B97F4A7C15ull, key});
+    }
+    FrozenHashMap<uint64_t, uint64_t> frozen(source);
+    CHECK(frozen.size() == source.size());
+    for (const auto& element : source) {
+        CHECK(frozen.at(element.first) == element.second);
+    }
+    for (uint64_t key = 1; key < 1000; ++key) {
+        CHECK(!frozen.contains(key));
+    }
+    size_t iterated = 0;
+    for (const auto& element : frozen) {
+        CHECK(source.at(element.first) == element.second);
+        ++iterated;
+    }
+    CHECK(iterated == source.size());
+
+    FrozenHashMap<std::string, int> words = {{"one", 1}, {"two", 2}, {"one", 3}};
+    CHECK(words.size() == 2);
+    CHECK(words.at("one") == 1);
+    CHECK(words.count("three") == 0);
+    CHECK(Throws<std::out_of_range>([&words] { words.at("three"); }));
+
+    FrozenHashMap<int, int> empty;
+    CHECK(empty.find(5) == empty.end());
+}
+
+// Sends every key to one of 1000 hash values, so most keys go to the overflow list.
+struct CollidingHash {
+    size_t operator()(uint64_t key) const {
+        return static_cast<size_t>(key % 1000);
+    }
+};
+
+void TestFrozenCollisions() {
+    HashMap<uint64_t, uint64_t, CollidingHash> source;
+    for (uint64_t key = 0; key < 5000; ++key) {
+        source.insert({key, key * 3});
+    }
+    FrozenHashMap<uint64_t, uint64_t, CollidingHash> frozen(source);
+    CHECK(frozen.size() == source.size());
+    for (uint64_t key = 0; key < 5000; ++key) {
+        CHECK(frozen.at(key) == key * 3);
+    }
+    for (uint64_t key = 5000; key < 10000; ++key) {
+        CHECK(!frozen.contains(key));
+    }
+    std::vector<uint64_t> keys;
+    for (const auto& element : frozen) {
+        CHECK(element.second == element.first * 3);
+        keys.push_back(element.first);
+    }
+    std::sort(keys.begin(), keys.end());
+    CHECK(std::adjacent_find(keys.begin(), keys.end()) == keys.end());
+    CHECK(keys.size() == source.size());
+}
+
+void TestFrozenLarge() {
+    const uint64_t count = 4000000;
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    pairs.reserve(count);
+    std::mt19937_64 random(7);
+    for (uint64_t i = 0; i < count; ++i) {
+        pairs.emplace_back(random(), i);
+    }
+    FrozenHashMap<uint64_t, uint64_t> frozen(pairs.begin(), pairs.end());
+    CHECK(frozen.size() == count);
+    for (const auto& pair : pairs) {
+        CHECK(frozen.at(pair.first) == pair.second);
+    }
+    for (uint64_t i = 0; i < 10000; ++i) {
+        CHECK(!frozen.contains(random()));
+    }
+}
+
+enum class Method { kGet, kPut, kDelete };
+
+constexpr auto kMethods =
+    MakeStaticHashMap<std::string_view, Method>({{"GET", Method::kGet}, {"PUT", Method::kPut}, {"DELETE", Method::kDelete}});
+static_assert(kMethods.at("PUT") == Method::kPut);
+static_assert(!kMethods.contains("PATCH"));
+
+void TestStatic() {
+    std::string get = "GET";
+    CHECK(kMethods.at(get) == Method::kGet);
+    CHECK(kMethods.find("HEAD") == kMethods.end());
+    CHECK(kMethods.size() == 3);
+
+    constexpr std::pair<int, int> kSquares[] = {{1, 1}, {2, 4}, {3, 9}, {-4, 16}};
+    constexpr StaticHashMap<int, int, 4> squares(kSquares);
+    for (int i = -10; i <= 10; ++i) {
+        CHECK(squares.contains(i) == (i == 1 || i == 2 || i == 3 || i == -4));
+    }
+    CHECK(squares.at(-4) == 16);
+    CHECK(Throws<std::out_of_range>([&squares] { squares.at(5); }));
+}
+
+void TestConcurrent() {
+    constexpr size_t kThreads = 4;
+    constexpr uint64_t kPerThread = 20000;
+    ConcurrentHashMap<uint64_t, uint64_t> map(16);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&map, t] {
+            // Every thread owns the keys congruent to t, inserts them, checks them, erases the
+            // odd ones and counts the even ones up through upsert.
+            for (uint64_t i = 0; i < kPerThread; ++i) {
+                map.insert({i * kThreads + t, 0});
+            }
+            for (uint64_t i = 0; i < kPerThread; ++i) {
+                uint64_t key = i * kThreads + t;
+                if (i % 2 == 1) {
+                    map.erase(key);
+                } else {
+                    map.upsert(key, [](uint64_t& value) { ++value; });
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(map.size() == kThreads * kPerThread / 2);
+    for (uint64_t key = 0; key < kThreads * kPerThread; ++key) {
+        uint64_t value = 0;
+        bool found = map.find(key, [&value](uint64_t stored) { value = stored; });
+        CHECK(found == ((key / kThreads) % 2 == 0));
+        CHECK(!found || value == 1);
+    }
+}
+
+void TestReadMostly() {
+    // The writer keeps the invariant that keys 0..n-1 are present with value n, so every
+    // snapshot a reader pins must be consistent with one n.
+    ReadMostlyHashMap<uint64_t, uint64_t> map;
+    std::atomic<bool> done{false};
+    std::atomic<bool> consistent{true};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+        readers.emplace_back([&map, &done, &consistent] {
+            auto reader = map.reader();
+            while (!done.load()) {
+                auto snapshot = reader.pin();
+                uint64_t n = snapshot->size();
+                for (uint64_t key = 0; key < n; ++key) {
+                    auto it = snapshot->find(key);
+                    if (it == snapshot->end() || it->second != n) {
+                        consistent.store(false);
+                    }
+                }
+            }
+        });
+    }
+    for (uint64_t n = 1; n <= 300; ++n) {
+        map.update([n](auto& next) {
+            for (uint64_t key = 0; key < n; ++key) {
+                next.insert_or_assign(key, n);
+            }
+        });
+    }
+    done.store(true);
+    for (std::thread& thread : readers) {
+        thread.join();
+    }
+    map.reclaim();
+    CHECK(consistent.load());
+    CHECK(map.retired_count() == 0);
+}
+
+// Counts distinct FastHash values of keys that differ only in the 8 bytes at offset varied,
+// with the 8 bytes before them set to secret. Such a word XORed with its secret used to zero
+// one factor of the multiply, so the product, and with it the seed and the varied bytes, were
+// lost and all these keys collided.
+size_t DistinctHashes(size_t size, size_t secret_offset, uint64_t secret, const FastHash<std::string>& hasher) {
+    constexpr size_t kKeys = 1000;
+    std::string key(size, 'k');
+    std::memcpy(&key[secret_offset], &secret, sizeof(secret));
+    std::vector<size_t> hashes;
+    for (uint64_t i = 0; i < kKeys; ++i) {
+        std::memcpy(&key[secret_offset + 8], &i, sizeof(i));
+        hashes.push_back(hasher(key));
+    }
+    std::sort(hashes.begin(), hashes.end());
+    return static_cast<size_t>(std::unique(hashes.begin(), hashes.end()) - hashes.begin());
+}
+
+void TestFastHashSecretWords() {
+    static_assert(std::is_same<FastHashMap<uint64_t, int>, HashMap<uint64_t, int, FastHash<uint64_t>>>::value);
+    static_assert(std::is_same<FastHashMap<double, int>, HashMap<double, int, std::hash<double>>>::value);
+    static_assert(std::is_same<HashMap<uint64_t, int>, HashMap<uint64_t, int, std::hash<uint64_t>>>::value);
+
+    using hashers_detail::kSecret;
+    for (int round = 0; round < 4; ++round) {
+        FastHash<std::string> hasher = FastHash<std::string>::Random();
+        // 17..48 bytes run through the 16-byte loop only.
+        CHECK(DistinctHashes(32, 0, kSecret[1], hasher) == 1000);
+        CHECK(DistinctHashes(48, 16, kSecret[1], hasher) == 1000);
+        // Longer keys go through the three lanes of the 48-byte loop first.
+        CHECK(DistinctHashes(96, 0, kSecret[1], hasher) == 1000);
+        CHECK(DistinctHashes(96, 16, kSecret[2], hasher) == 1000);
+        CHECK(DistinctHashes(96, 32, kSecret[3], hasher) == 1000);
+        CHECK(DistinctHashes(200, 64, kSecret[3], hasher) == 1000);
+    }
+
+    // The seed still matters for such keys.
+    std::string key(32, 'k');
+    std::memcpy(&key[0], &kSecret[1], sizeof(uint64_t));
+    CHECK(FastHash<std::string>(1)(key) != FastHash<std::string>(2)(key));
+}
+
+void TestSipHashKeys() {
+    SipHash13<std::string> first = SipHash13<std::string>::Random();
+    SipHash13<std::string> second = SipHash13<std::string>::Random();
+    CHECK(first.key0 != second.key0 || first.key1 != second.key1);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; ++i) {
+        // Lengths 0..39 cover the partial last word and several full words.
+        keys.push_back(std::string(i % 40, 'k') + std::to_string(i));
+    }
+    std::vector<size_t> under_first;
+    std::vector<size_t> under_second;
+    for (const std::string& key : keys) {
+        CHECK(first(key) == SipHash13<std::string>(first.key0, first.key1)(key));
+        CHECK(first(key) == first(std::string_view(key)));
+        under_first.push_back(first(key));
+        under_second.push_back(second(key));
+    }
+    size_t differing = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        differing += under_first[i] != under_second[i];
+    }
+    CHECK(differing == keys.size());
+    std::sort(under_first.begin(), under_first.end());
+    CHECK(std::unique(under_first.begin(), under_first.end()) == under_first.end());
+
+    // Each half of the key matters.
+    CHECK(SipHash13<uint64_t>(1, 2)(42) != SipHash13<uint64_t>(1, 3)(42));
+    CHECK(SipHash13<uint64_t>(1, 2)(42) != SipHash13<uint64_t>(4, 2)(42));
+
+    HashMap<std::string, int, SipHash13<std::string>, std::equal_to<>> map(SipHash13<std::string>::Random());
+    for (int i = 0; i < 1000; ++i) {
+        map.insert({keys[i], i});
+    }
+    for (int i = 0; i < 1000; ++i) {
+        CHECK(map.find(std::string_view(keys[i]))->second == i);
+    }
+}
+
+#if defined(HASHMAP_ENABLE_STATS)
+// Sends every key to bucket 0, so that the n-th key inserted sits n - 1 slots from home.
+struct ConstantHash {
+    size_t operator()(uint64_t) const {
+        return 0;
+    }
+};
+
+template <class ProbingPolicy>
+void RunStatsCollisions() {
+    HashMap<uint64_t, uint64_t, ConstantHash, std::equal_to<uint64_t>, ProbingPolicy> map;
+    map.reserve(64);
+    for (uint64_t key = 0; key < 5; ++key) {
+        map.insert({key, key});
+    }
+    auto stats = map.stats();
+    CHECK(stats.max_psl == 4);
+    CHECK(stats.psl_histogram == std::vector<size_t>(5, 1));
+
+    map.reset_stats();
+    for (uint64_t key = 0; key < 5; ++key) {
+        CHECK(map.contains(key));
+    }
+    CHECK(!map.contains(5));
+    stats = map.stats();
+    CHECK(stats.hits == 5 && stats.misses == 1);
+    if constexpr (!ProbingPolicy::kUseControlBytes) {
+        // The keys at distances 0..4 take 1..5 probes; the miss also reads the empty slot.
+        CHECK(stats.hit_probes == 15 && stats.miss_probes == 6);
+    }
+}
+
+void TestStats() {
+    RunStatsCollisions<LinearProbing>();
+    RunStatsCollisions<GroupProbing>();
+
+    // Every growth is one rebuild, or one migration in incremental mode.
+    for (bool incremental : {false, true}) {
+        HashMap<uint64_t, uint64_t> map;
+        map.incremental_rehash(incremental);
+        size_t rehashes = map.stats().rehash_count;
+        size_t growths = 0;
+        size_t bucket_count = map.bucket_count();
+        for (uint64_t key = 0; key < 100000; ++key) {
+            map.insert({key, key});
+            if (map.bucket_count() != bucket_count) {
+                bucket_count = map.bucket_count();
+                ++growths;
+            }
+        }
+        CHECK(growths > 5);
+        CHECK(map.stats().rehash_count - rehashes == growths);
+        CHECK(map.stats().psl_histogram.size() == map.stats().max_psl + 1);
+    }
+}
+#endif
+
+struct Test {
+    const char* name;
+    void (*function)();
+};
+
+const Test kTests[] = {
+    {"DifferentialLinear", &TestDifferentialLinear},
+    {"DifferentialGroup", &TestDifferentialGroup},
+    {"StringKeysWithCollisions", &TestStringKeysWithCollisions},
+    {"TransparentLookup", &TestTransparentLookup},
+    {"MovedFrom", &TestMovedFrom},
+    {"MemoryUsage", &TestMemoryUsage},
+    {"IncrementalMigration", &TestIncrementalMigration},
+    {"IncrementalBoundedWork", &TestIncrementalBoundedWork},
+    {"EraseIf", &TestEraseIf},
+    {"Parallel", &TestParallel},
+    {"MappedRoundTrip", &TestMappedRoundTrip},
+    {"MappedVerify", &TestMappedVerify},
+    {"Frozen", &TestFrozen},
+    {"FrozenCollisions", &TestFrozenCollisions},
+    {"FrozenLarge", &TestFrozenLarge},
+    {"Static", &TestStatic},
+    {"FastHashSecretWords", &TestFastHashSecretWords},
+    {"SipHashKeys", &TestSipHashKeys},
+#if defined(HASHMAP_ENABLE_STATS)
+    {"Stats", &TestStats},
+#endif
+    {"Concurrent", &TestConcurrent},
+    {"ReadMostly", &TestReadMostly},
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int failed = 0;
+    int run = 0;
+    for (const Test& test : kTests) {
+        if (argc > 1 && std::strcmp(argv[1], test.name) != 0) {
+            continue;
+        }
+        ++run;
+        try {
+            test.function();
+            std::printf("[ OK ] %s\n", test.name);
+        } catch (const std::exception& error) {
+            std::printf("[FAIL] %s: %s\n", test.name, error.what());
+            ++failed;
+        }
+    }
+    if (run == 0) {
+        std::printf("no test named %s\n", argv[1]);
+        return 1;
+    }
+    std::printf("%d of %d tests passed\n", run - failed, run);
+    return failed == 0 ? 0 : 1;
+}